@@ -1,8 +1,11 @@
 #include "client.h"
 #include "ui_clientwidget.h"
 
+#include <algorithm>
+
+#include <QCheckBox>
 #include <QCloseEvent>
-#include <QDataStream>
+#include <QDateTimeEdit>
 #include <QHostAddress>
 #include <QMessageBox>
 #include <QTableWidgetItem>
@@ -15,6 +18,10 @@ namespace
 
 int customTimerIntervalMsec() { return 1000; }
 
+int fallbackTimerIntervalMsec() { return 10000; }
+
+int outputBufferSize() { return 512; }
+
 enum Column
 {
     Address = 0,
@@ -40,8 +47,14 @@ Client::Client(QWidget* parent) :
             this, &Client::slotDisconnect);
     connect(m_ui->cancelButton, &QPushButton::clicked,
             this, &Client::close);
+    connect(m_ui->applyFilterButton, &QPushButton::clicked,
+            this, &Client::slotApplyFilter);
+    connect(m_ui->sinceCheckBox, &QCheckBox::toggled,
+            m_ui->sinceDateTimeEdit, &QDateTimeEdit::setEnabled);
+    m_ui->sinceDateTimeEdit->setDateTime(QDateTime::currentDateTime());
 
     m_timer->setInterval(::customTimerIntervalMsec());
+    m_output.reserve(::outputBufferSize());
 
     connect(m_timer, &QTimer::timeout,
             this, &Client::slotTimeout);
@@ -81,9 +94,13 @@ void Client::removeConnection()
         m_socket = nullptr;
 
         m_incomingPort = 0;
-        m_receivedBytes.clear();
+        m_codec = Message::Codec::Xml;
+        m_decoder.clear();
     }
 
+    m_clients.clear();
+    m_generation = 0;
+    m_receiving = false;
     m_ui->clientsTableWidget->clearContents();
     m_ui->clientsTableWidget->setRowCount(0);
 }
@@ -94,6 +111,7 @@ void Client::slotConnect()
                                                                           : QAbstractSocket::UdpSocket);
     if (createConnection(type))
     {
+        m_timer->setInterval(::customTimerIntervalMsec());
         m_timer->start();
         enableControls(false);
     }
@@ -110,6 +128,33 @@ void Client::slotDisconnect()
     enableControls(true);
 }
 
+void Client::slotApplyFilter()
+{
+    RosterFilter filter;
+    if (!filter.setSubnet(m_ui->subnetLineEdit->text()))
+    {
+        QMessageBox::warning(this,
+                             tr("Filter error"),
+                             tr("Invalid subnet: %1").arg(m_ui->subnetLineEdit->text()));
+        return;
+    }
+    if (m_ui->sinceCheckBox->isChecked())
+    {
+        filter.since = m_ui->sinceDateTimeEdit->dateTime().toMSecsSinceEpoch();
+    }
+    filter.transport = static_cast<RosterFilter::Transport>(m_ui->transportComboBox->currentIndex());
+    filter.offset = static_cast<quint32>(m_ui->offsetSpinBox->value());
+    filter.limit = static_cast<quint32>(m_ui->limitSpinBox->value());
+
+    // отображаемый список получен с прежним фильтром - следующий ответ заменит его полностью.
+    m_filter = filter;
+    m_generation = 0;
+    if (m_socket != nullptr)
+    {
+        sendInfoRequest();
+    }
+}
+
 void Client::enableControls(bool enabled)
 {
     m_ui->tcpRadioButton->setEnabled(enabled);
@@ -206,12 +251,22 @@ void Client::sendMessage(Message::Type type)
     {
         Message request(type);
         request.setBackwardPort(m_incomingPort);
-        QByteArray message;
+        request.setCodec(m_codec);
+        request.setPreferredCodec(Message::Codec::Binary);
+        request.setAcceptsChunks(true);
+        request.setAcceptsCompression(true);
+        if (type == Message::Type::InfoRequest)
         {
-            QDataStream output(&message, QIODevice::WriteOnly);
-            output << request;
+            // на запрос с фильтром сервер всегда отвечает полным отобранным списком.
+            request.setFilter(m_filter);
+            if (m_filter.isEmpty())
+            {
+                request.setGeneration(m_generation);
+            }
         }
-        m_socket->write(message);
+        m_output.resize(0);
+        request.serializeInto(m_output);
+        m_socket->write(m_output);
     }
 }
 
@@ -220,7 +275,7 @@ void Client::slotReadTcpResponse()
     QTcpSocket* socket = qobject_cast<QTcpSocket*>(sender());
     if (socket != nullptr)
     {
-        m_receivedBytes.append(socket->readAll());
+        m_decoder.append(socket->readAll());
         tryProcessResponse();
     }
 }
@@ -234,7 +289,7 @@ void Client::slotReadUdpResponse()
         {
             QByteArray datagram(socket->pendingDatagramSize(), '\0');
             socket->readDatagram(datagram.data(), datagram.size());
-            m_receivedBytes.append(datagram);
+            m_decoder.append(datagram);
         }
         tryProcessResponse();
     }
@@ -242,59 +297,186 @@ void Client::slotReadUdpResponse()
 
 void Client::tryProcessResponse()
 {
-    if (m_receivedBytes.isEmpty())
+    Message response;
+    while (m_decoder.next(&response))
     {
-        return;
+        if (response.codec() == Message::Codec::Binary)
+        {
+            // сервер поддерживает двоичный формат - дальнейшие запросы отправляются в нём.
+            m_codec = Message::Codec::Binary;
+        }
+
+        if (response.isPushed())
+        {
+            // сервер сам присылает изменения - периодические запросы остаются только на случай потери уведомлений.
+            m_timer->setInterval(::fallbackTimerIntervalMsec());
+            m_timer->start();
+        }
+
+        if (   response.isPushed()
+            && !m_filter.isEmpty())
+        {
+            // уведомление содержит полный список клиентов - отобранный список запрашивается заново
+            // (один раз на уведомление, даже если оно передаётся частями).
+            if (   response.type() == Message::Type::InfoResponse
+                || response.type() == Message::Type::InfoBegin)
+            {
+                sendInfoRequest();
+            }
+            continue;
+        }
+
+        if (   response.generation() > 0
+            && response.generation() < m_generation)
+        {
+            // запоздавший ответ на один из предыдущих запросов.
+            continue;
+        }
+
+        switch (response.type())
+        {
+        case Message::Type::InfoResponse:
+            m_receiving = false;
+            showClientsList(response.takeClientsInfo());
+            m_generation = response.generation();
+            break;
+        case Message::Type::InfoBegin:
+            // список отображается по мере приёма частей, поколение запоминается только после приёма всего списка.
+            beginClientsList(response.totalClients());
+            m_generation = 0;
+            break;
+        case Message::Type::InfoChunk:
+            if (m_receiving)
+            {
+                appendClientsList(response.takeClientsInfo());
+            }
+            break;
+        case Message::Type::InfoEnd:
+            if (m_receiving)
+            {
+                m_receiving = false;
+                resizeClientsColumns();
+                // часть списка потеряна (например, датаграмма) - следующим запросом будет получен полный список.
+                m_generation = (m_clients.size() == m_expectedClients ? response.generation()
+                                                                      : 0);
+            }
+            break;
+        case Message::Type::InfoDelta:
+            m_receiving = false;
+            // если изменения не соответствуют отображаемому списку - следующим запросом будет получен полный список.
+            m_generation = applyClientsDelta(response.removedClientsInfo(), response.clientsInfo()) ? response.generation()
+                                                                                                     : 0;
+            break;
+        case Message::Type::InfoNotModified:
+        default:
+            break;
+        }
     }
 
-    quint32 expectedSize = 0;
+    if (m_decoder.isCorrupted())
     {
-        QDataStream input(&m_receivedBytes, QIODevice::ReadOnly);
-        input >> expectedSize;
+        m_timer->stop();
+        removeConnection();
+        enableControls(true);
+        QMessageBox::warning(this,
+                             tr("Connection error"),
+                             tr("Server sent a frame larger than %1 bytes").arg(Message::maxFrameSize));
     }
+}
+
+void Client::showClientsList(ClientInfoList&& clients)
+{
+    m_clients = std::move(clients);
 
-    if (   expectedSize > 0
-        && static_cast<quint32>(m_receivedBytes.size() - sizeof(expectedSize)) >= expectedSize)
+    m_ui->clientsTableWidget->clearContents();
+    m_ui->clientsTableWidget->setRowCount(static_cast<int>(m_clients.size()));
+
+    for (int row = 0, sz = static_cast<int>(m_clients.size()); row < sz; ++row)
     {
-        Message response;
-        {
-            QDataStream input(&m_receivedBytes, QIODevice::ReadOnly);
-            input >> response;
-        }
+        setClientRow(row, m_clients[row]);
+    }
 
-        m_receivedBytes = m_receivedBytes.right(m_receivedBytes.size() - sizeof(expectedSize) - expectedSize);
+    resizeClientsColumns();
+}
 
-        showClientsList(response.clientsInfo());
+void Client::beginClientsList(quint64 total)
+{
+    m_receiving = true;
+    m_expectedClients = total;
 
-        tryProcessResponse();
+    // количество получено от сервера, поэтому резервируется не больше, чем помещается в один кадр.
+    m_clients.clear();
+    m_clients.reserve(static_cast<std::size_t>(qMin<quint64>(total, Message::maxFrameSize / sizeof(ClientInfo))));
+    m_ui->clientsTableWidget->clearContents();
+    m_ui->clientsTableWidget->setRowCount(0);
+}
+
+void Client::appendClientsList(ClientInfoList&& clients)
+{
+    int row = static_cast<int>(m_clients.size());
+    m_ui->clientsTableWidget->setRowCount(row + static_cast<int>(clients.size()));
+    for (ClientInfo& each : clients)
+    {
+        setClientRow(row++, each);
+        m_clients.push_back(std::move(each));
     }
 }
 
-void Client::showClientsList(const QList<ClientInfo>& clients)
+bool Client::applyClientsDelta(const ClientInfoList& removed, const ClientInfoList& added)
 {
-    m_ui->clientsTableWidget->clearContents();
-    m_ui->clientsTableWidget->setRowCount(clients.count());
+    bool consistent = true;
+
+    for (const ClientInfo& each : removed)
+    {
+        ClientInfoList::iterator founded = std::find(m_clients.begin(), m_clients.end(), each);
+        if (founded == m_clients.end())
+        {
+            consistent = false;
+            continue;
+        }
+        int row = static_cast<int>(founded - m_clients.begin());
+        m_clients.erase(founded);
+        m_ui->clientsTableWidget->removeRow(row);
+    }
 
-    for (int row = 0, sz = clients.size(); row < sz; ++row)
+    m_clients.reserve(m_clients.size() + added.size());
+    for (const ClientInfo& each : added)
     {
-        const ClientInfo& each = clients.at(row);
-
-        QTableWidgetItem* item = new QTableWidgetItem(each.address);
-        item->setFlags(item->flags() ^ Qt::ItemIsEditable);
-        item->setTextAlignment(Qt::AlignCenter);
-        m_ui->clientsTableWidget->setItem(row, Address, item);
-
-        item = new QTableWidgetItem(QString::number(each.port));
-        item->setFlags(item->flags() ^ Qt::ItemIsEditable);
-        item->setTextAlignment(Qt::AlignCenter);
-        m_ui->clientsTableWidget->setItem(row, Port, item);
-
-        item = new QTableWidgetItem(each.datetime.toString("hh:mm:ss dd-MM-yyyy"));
-        item->setFlags(item->flags() ^ Qt::ItemIsEditable);
-        item->setTextAlignment(Qt::AlignCenter);
-        m_ui->clientsTableWidget->setItem(row, Datetime, item);
+        if (std::find(m_clients.begin(), m_clients.end(), each) != m_clients.end())
+        {
+            consistent = false;
+            continue;
+        }
+        int row = static_cast<int>(m_clients.size());
+        m_clients.push_back(each);
+        m_ui->clientsTableWidget->insertRow(row);
+        setClientRow(row, each);
     }
 
+    resizeClientsColumns();
+    return consistent;
+}
+
+void Client::setClientRow(int row, const ClientInfo& client)
+{
+    QTableWidgetItem* item = new QTableWidgetItem(client.addressString());
+    item->setFlags(item->flags() ^ Qt::ItemIsEditable);
+    item->setTextAlignment(Qt::AlignCenter);
+    m_ui->clientsTableWidget->setItem(row, Address, item);
+
+    item = new QTableWidgetItem(QString::number(client.port));
+    item->setFlags(item->flags() ^ Qt::ItemIsEditable);
+    item->setTextAlignment(Qt::AlignCenter);
+    m_ui->clientsTableWidget->setItem(row, Port, item);
+
+    item = new QTableWidgetItem(client.datetime().toString("hh:mm:ss dd-MM-yyyy"));
+    item->setFlags(item->flags() ^ Qt::ItemIsEditable);
+    item->setTextAlignment(Qt::AlignCenter);
+    m_ui->clientsTableWidget->setItem(row, Datetime, item);
+}
+
+void Client::resizeClientsColumns()
+{
     m_ui->clientsTableWidget->horizontalHeader()->setResizeContentsPrecision(0);
     m_ui->clientsTableWidget->resizeColumnsToContents();
     m_ui->clientsTableWidget->horizontalHeader()->setSectionResizeMode(Datetime, QHeaderView::Stretch);
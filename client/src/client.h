@@ -5,10 +5,10 @@
 #include <QByteArray>
 #include <QWidget>
 
+#include <framedecoder.h>
 #include <protocol.h>
 
 class QTimer;
-template <typename T> class QList;
 
 namespace Ui
 {
@@ -38,13 +38,19 @@ private slots:
     void slotConnect();
     void slotDisconnect();
     void slotTimeout();
+    void slotApplyFilter();
 
     void slotReadTcpResponse();
     void slotReadUdpResponse();
 
 private:
     void enableControls(bool enabled);
-    void showClientsList(const QList<ClientInfo>& clients);
+    void showClientsList(ClientInfoList&& clients);
+    void beginClientsList(quint64 total);
+    void appendClientsList(ClientInfoList&& clients);
+    bool applyClientsDelta(const ClientInfoList& removed, const ClientInfoList& added);
+    void setClientRow(int row, const ClientInfo& client);
+    void resizeClientsColumns();
 
     bool createConnection(QAbstractSocket::SocketType type);
     void removeConnection();
@@ -63,7 +69,15 @@ private:
 
     QAbstractSocket* m_socket = nullptr; //!< сокет, обеспечивающий связь с сервером.
     quint16 m_incomingPort = 0;          //!< порт, на котором ожидается ответ от сервера.
-    QByteArray m_receivedBytes;          //!< буфер для принимаемой от сервера информации.
+    Message::Codec m_codec = Message::Codec::Xml; //!< формат отправляемых запросов (двоичный - после того, как сервер ответил в нём).
+    FrameDecoder m_decoder;              //!< буфер для принимаемой от сервера информации.
+    QByteArray m_output;                 //!< буфер отправляемых запросов (используется повторно).
+
+    ClientInfoList m_clients;            //!< отображаемый список клиентов (в порядке строк таблицы).
+    quint64 m_generation = 0;            //!< поколение отображаемого списка клиентов (0 - список не получен).
+    bool m_receiving = false;            //!< принимается список клиентов, передаваемый частями.
+    quint64 m_expectedClients = 0;       //!< количество клиентов в принимаемом по частям списке.
+    RosterFilter m_filter;               //!< условия отбора клиентов, передаваемые в запросах.
 
 };
 
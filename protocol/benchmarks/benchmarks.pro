@@ -0,0 +1,36 @@
+TEMPLATE = app
+PROJECT = protocol-benchmark
+TARGET = $$PROJECT
+
+QT += core \
+      network \
+      xml \
+      testlib
+QT -= gui
+
+CONFIG += warn_on
+QMAKE_CXXFLAGS += -Wall -Werror -Wextra -pedantic-errors
+QMAKE_CXXFLAGS += -std=c++14
+
+DESTDIR = $$PWD/build/sbin
+OBJECTS_DIR = $$PWD/build/obj
+MOC_DIR = $$PWD/build/moc
+
+SOURCES = \
+    ../src/binarycodec.cpp \
+    ../src/framedecoder.cpp \
+    ../src/protocol.cpp \
+    src/main.cpp
+
+HEADERS = \
+    ../src/binarycodec.h \
+    ../src/framedecoder.h \
+    ../src/protocol.h
+
+#installs
+target.path = $$PREFIX/sbin
+
+INSTALLS += \
+    target
+
+INCLUDEPATH += ../src
@@ -0,0 +1,206 @@
+#include <QtTest>
+
+#include <QByteArray>
+#include <QDateTime>
+#include <QDebug>
+#include <QDomDocument>
+#include <QDomElement>
+#include <QHostAddress>
+#include <QRegExp>
+#include <QString>
+
+#include "protocol.h"
+
+namespace
+{
+
+const int rosterSize = 10000;
+
+/**
+ * @brief  makeRoster - формирует ответ со списком из count клиентов.
+ * @param  count - количество клиентов.
+ * @return сообщение InfoResponse.
+ */
+Netcom::Message makeRoster(int count)
+{
+    Netcom::Message result(Netcom::Message::Type::InfoResponse);
+    QDateTime connected = QDateTime::fromString("10:00:00 28-06-2017", "hh:mm:ss dd-MM-yyyy");
+    result.reserveClientsInfo(static_cast<std::size_t>(count));
+    for (int i = 0; i < count; ++i)
+    {
+        result.emplaceClientInfo(QHostAddress(0x0A000000u + i),
+                                 static_cast<quint16>(1024 + i % 60000),
+                                 connected.addSecs(i).toMSecsSinceEpoch());
+    }
+    return result;
+}
+
+/**
+ * @brief addRosterRows - добавляет строки данных теста: размер списка клиентов и формат кодирования.
+ */
+void addRosterRows()
+{
+    QTest::addColumn<int>("count");
+    QTest::addColumn<bool>("binary");
+    for (int count : { 100, 1000, 10000, 100000 })
+    {
+        QTest::newRow(qPrintable(QString("xml/%1").arg(count))) << count << false;
+        QTest::newRow(qPrintable(QString("binary/%1").arg(count))) << count << true;
+    }
+}
+
+/**
+ * @brief  rosterFrame - формирует кадр ответа со списком из count клиентов.
+ * @param  count - количество клиентов.
+ * @param  binary - тело кодируется в двоичном формате (иначе - XML).
+ * @return кадр (размер + тело).
+ */
+QByteArray rosterFrame(int count, bool binary)
+{
+    Netcom::Message roster = ::makeRoster(count);
+    roster.setCodec(binary ? Netcom::Message::Codec::Binary
+                           : Netcom::Message::Codec::Xml);
+    QByteArray result;
+    roster.serializeInto(result);
+    return result;
+}
+
+/**
+ * @brief  domParse - прежний разбор XML через QDomDocument (точка отсчёта для сравнения).
+ * @param  raw - XML-документ.
+ * @return список клиентов.
+ */
+QList<Netcom::ClientInfo> domParse(const QByteArray& raw)
+{
+    QList<Netcom::ClientInfo> result;
+
+    QDomDocument doc;
+    if (doc.setContent(raw))
+    {
+        QDomNodeList messageChildren = doc.documentElement().elementsByTagName("message");
+        for (int i = 0, isz = messageChildren.size(); i < isz; ++i)
+        {
+            QDomNodeList clientsChildren = messageChildren.item(i).toElement().elementsByTagName("clients");
+            for (int j = 0, jsz = clientsChildren.size(); j < jsz; ++j)
+            {
+                QDomNodeList clientChildren = clientsChildren.item(j).toElement().elementsByTagName("client");
+                for (int k = 0, ksz = clientChildren.size(); k < ksz; ++k)
+                {
+                    QDomElement client = clientChildren.item(k).toElement();
+                    result.append(Netcom::ClientInfo(client.attribute("address"),
+                                                     client.attribute("port").toUInt(),
+                                                     QDateTime::fromString(client.attribute("datetime"), "hh:mm:ss dd-MM-yyyy")));
+                }
+            }
+        }
+    }
+    return result;
+}
+
+}
+
+class ProtocolBenchmark : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase()
+    {
+        m_roster = ::makeRoster(::rosterSize);
+        m_xml = m_roster.serialize();
+    }
+
+    void slotDomParseBenchmark()
+    {
+        QList<Netcom::ClientInfo> parsed;
+        QBENCHMARK
+        {
+            parsed = ::domParse(m_xml);
+        }
+        QCOMPARE(parsed.size(), ::rosterSize);
+    }
+
+    void slotStreamParseBenchmark()
+    {
+        Netcom::Message parsed;
+        QBENCHMARK
+        {
+            parsed = Netcom::Message::parse(m_xml);
+        }
+        QCOMPARE(parsed.clientsInfo(), m_roster.clientsInfo());
+    }
+
+    void slotLegacyStreamParseBenchmark()
+    {
+        // разбор времени из строки datetime, как в сообщениях прежних версий без msecs.
+        QByteArray legacy = QString::fromUtf8(m_xml).remove(QRegExp(" msecs=\"-?\\d+\"")).toUtf8();
+        QVERIFY(!legacy.contains("msecs"));
+
+        Netcom::Message parsed;
+        QBENCHMARK
+        {
+            parsed = Netcom::Message::parse(legacy);
+        }
+        QCOMPARE(parsed.clientsInfo(), m_roster.clientsInfo());
+    }
+
+    void slotCompressBenchmark_data()
+    {
+        ::addRosterRows();
+    }
+
+    void slotCompressBenchmark()
+    {
+        QFETCH(int, count);
+        QFETCH(bool, binary);
+
+        const QByteArray frame = ::rosterFrame(count, binary);
+        QByteArray compressed;
+        QBENCHMARK
+        {
+            compressed = Netcom::Message::compressFrame(frame, 0);
+        }
+        QVERIFY(compressed.size() < frame.size());
+
+        // время сжатия выводит QBENCHMARK, выигрыш в размере - здесь.
+        qInfo().noquote() << QString("%1 clients, %2: %3 -> %4 bytes (%5%)")
+                             .arg(count)
+                             .arg(binary ? "binary" : "xml")
+                             .arg(frame.size())
+                             .arg(compressed.size())
+                             .arg(100.0 * compressed.size() / frame.size(), 0, 'f', 1);
+    }
+
+    void slotUncompressBenchmark_data()
+    {
+        ::addRosterRows();
+    }
+
+    void slotUncompressBenchmark()
+    {
+        QFETCH(int, count);
+        QFETCH(bool, binary);
+
+        const QByteArray frame = ::rosterFrame(count, binary);
+        const QByteArray compressed = Netcom::Message::compressFrame(frame, 0);
+        const int headerSize = static_cast<int>(sizeof(quint32));
+
+        bool ok = false;
+        QByteArray payload;
+        QBENCHMARK
+        {
+            ok = Netcom::Message::uncompressPayload(compressed.constData() + headerSize, compressed.size() - headerSize, &payload);
+        }
+        QVERIFY(ok);
+        QCOMPARE(payload, frame.mid(headerSize));
+    }
+
+private:
+    Netcom::Message m_roster; //!< исходный список клиентов.
+    QByteArray m_xml;         //!< список клиентов в XML.
+
+};
+
+QTEST_MAIN(ProtocolBenchmark)
+
+#include "main.moc"
@@ -6,6 +6,7 @@ CONFIG += console
 CONFIG -= app_bundle
 
 QT += core \
+      network \
       xml
 QT -= gui
 
@@ -18,13 +19,17 @@ DESTDIR = $$PWD/build/bin
 OBJECTS_DIR = $$PWD/build/obj
 
 SOURCES += \
+    src/binarycodec.cpp \
+    src/framedecoder.cpp \
     src/protocol.cpp
 
 PUB_HEADERS += \
+    src/framedecoder.h \
     src/protocol.h
 
 HEADERS += \
-    $$PUB_HEADERS
+    $$PUB_HEADERS \
+    src/binarycodec.h
 
 # installs
 target.path = $$PREFIX/lib
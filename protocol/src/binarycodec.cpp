@@ -0,0 +1,578 @@
+#include "binarycodec.h"
+
+#include <cstring>
+#include <limits>
+
+#include <QByteArray>
+#include <QtEndian>
+
+#include "protocol.h"
+
+namespace
+{
+
+// сигнатура двоичного формата.
+quint8 binaryMagic() { return 0xB5; }
+
+// версия двоичного формата.
+quint8 binaryVersion() { return 1; }
+
+// минимальный размер записи о клиенте: адрес IPv4 (семейство 1 + 4), порт (1), время (8).
+quint64 minClientSize() { return 14; }
+
+/**
+ * @enum  Tag
+ * @brief Теги полей двоичного сообщения.
+ */
+enum Tag : quint8
+{
+    BackwardPortTag = 1,
+    PreferredCodecTag,
+    ClientsTag,
+    GenerationTag,
+    RemovedClientsTag,
+    PushedTag,
+    SinceTag,
+    SubnetTag,
+    TransportTag,
+    OffsetTag,
+    LimitTag,
+    AcceptsChunksTag,
+    TotalClientsTag,
+    AcceptsCompressionTag
+};
+
+/**
+ * @enum  AddressFamily
+ * @brief Способ кодирования адреса клиента.
+ */
+enum AddressFamily : quint8
+{
+    IPv4Address = 4,
+    IPv6Address = 6
+};
+
+void writeUInt8(QByteArray& to, quint8 value)
+{
+    to.append(static_cast<char>(value));
+}
+
+void writeVarUInt(QByteArray& to, quint64 value)
+{
+    while (value >= 0x80)
+    {
+        to.append(static_cast<char>((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    to.append(static_cast<char>(value));
+}
+
+template <typename T>
+void writeBigEndian(QByteArray& to, T value)
+{
+    uchar raw[sizeof(T)];
+    qToBigEndian(value, raw);
+    to.append(reinterpret_cast<const char*>(raw), sizeof(T));
+}
+
+int beginField(QByteArray& to, Tag tag)
+{
+    writeUInt8(to, tag);
+    int position = to.size();
+    to.resize(position + static_cast<int>(sizeof(quint32)));
+    return position;
+}
+
+void endField(QByteArray& to, int position)
+{
+    quint32 length = to.size() - position - sizeof(quint32);
+    qToBigEndian(length, reinterpret_cast<uchar*>(to.data() + position));
+}
+
+void writeAddress(QByteArray& to, const Netcom::ClientInfo& client)
+{
+    if (client.isIPv4())
+    {
+        writeUInt8(to, IPv4Address);
+        to.append(reinterpret_cast<const char*>(client.address + 12), 4);
+    }
+    else
+    {
+        writeUInt8(to, IPv6Address);
+        to.append(reinterpret_cast<const char*>(client.address), sizeof(client.address));
+    }
+}
+
+void writeFilter(QByteArray& to, const Netcom::RosterFilter& filter)
+{
+    if (filter.since != Netcom::ClientInfo::invalidTime)
+    {
+        int field = beginField(to, SinceTag);
+        writeBigEndian<qint64>(to, filter.since);
+        endField(to, field);
+    }
+    if (filter.prefixLength >= 0)
+    {
+        int field = beginField(to, SubnetTag);
+        writeUInt8(to, static_cast<quint8>(filter.prefixLength));
+        to.append(reinterpret_cast<const char*>(filter.network), sizeof(filter.network));
+        endField(to, field);
+    }
+    if (filter.transport != Netcom::RosterFilter::Transport::Any)
+    {
+        int field = beginField(to, TransportTag);
+        writeUInt8(to, static_cast<quint8>(filter.transport));
+        endField(to, field);
+    }
+    if (filter.offset > 0)
+    {
+        int field = beginField(to, OffsetTag);
+        writeVarUInt(to, filter.offset);
+        endField(to, field);
+    }
+    if (filter.limit > 0)
+    {
+        int field = beginField(to, LimitTag);
+        writeVarUInt(to, filter.limit);
+        endField(to, field);
+    }
+}
+
+void writeClients(QByteArray& to, Tag tag, const Netcom::ClientInfoList& clients)
+{
+    int field = beginField(to, tag);
+    writeVarUInt(to, clients.size());
+    for (const Netcom::ClientInfo& each : clients)
+    {
+        writeAddress(to, each);
+        writeVarUInt(to, each.port);
+        writeBigEndian<qint64>(to, each.connected);
+    }
+    endField(to, field);
+}
+
+/**
+ * @class Reader
+ * @brief Последовательное чтение полей двоичного сообщения с контролем границ.
+ */
+class Reader
+{
+public:
+    Reader(const char* begin, const char* end) :
+        m_pos(reinterpret_cast<const uchar*>(begin)),
+        m_end(reinterpret_cast<const uchar*>(end))
+    {
+
+    }
+
+    bool atEnd() const
+    {
+        return m_pos >= m_end;
+    }
+
+    quint64 remaining() const
+    {
+        return static_cast<quint64>(m_end - m_pos);
+    }
+
+    bool readUInt8(quint8* value)
+    {
+        if (atEnd())
+        {
+            return false;
+        }
+        *value = *m_pos++;
+        return true;
+    }
+
+    bool readVarUInt(quint64* value)
+    {
+        quint64 result = 0;
+        for (int shift = 0; shift < 64; shift += 7)
+        {
+            quint8 byte = 0;
+            if (!readUInt8(&byte))
+            {
+                return false;
+            }
+            result |= static_cast<quint64>(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0)
+            {
+                *value = result;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool readUInt32(quint32* value)
+    {
+        quint64 raw = 0;
+        if (   !readVarUInt(&raw)
+            || raw > std::numeric_limits<quint32>::max())
+        {
+            return false;
+        }
+        *value = static_cast<quint32>(raw);
+        return true;
+    }
+
+    bool readPort(quint16* value)
+    {
+        quint64 raw = 0;
+        if (   !readVarUInt(&raw)
+            || raw > std::numeric_limits<quint16>::max())
+        {
+            return false;
+        }
+        *value = static_cast<quint16>(raw);
+        return true;
+    }
+
+    template <typename T>
+    bool readBigEndian(T* value)
+    {
+        const char* raw = nullptr;
+        if (!readBytes(sizeof(T), &raw))
+        {
+            return false;
+        }
+        *value = qFromBigEndian<T>(reinterpret_cast<const uchar*>(raw));
+        return true;
+    }
+
+    bool readBytes(quint64 size, const char** data)
+    {
+        if (size > static_cast<quint64>(m_end - m_pos))
+        {
+            return false;
+        }
+        *data = reinterpret_cast<const char*>(m_pos);
+        m_pos += size;
+        return true;
+    }
+
+private:
+    const uchar* m_pos; //!< текущая позиция чтения.
+    const uchar* m_end; //!< конец доступных данных.
+
+};
+
+bool readAddress(Reader& from, Netcom::ClientInfo* client)
+{
+    quint8 family = 0;
+    if (!from.readUInt8(&family))
+    {
+        return false;
+    }
+
+    const char* raw = nullptr;
+    switch (family)
+    {
+    case IPv4Address:
+        if (!from.readBytes(4, &raw))
+        {
+            return false;
+        }
+        std::memset(client->address, 0, 10);
+        client->address[10] = 0xFF;
+        client->address[11] = 0xFF;
+        std::memcpy(client->address + 12, raw, 4);
+        return true;
+    case IPv6Address:
+        if (!from.readBytes(sizeof(client->address), &raw))
+        {
+            return false;
+        }
+        std::memcpy(client->address, raw, sizeof(client->address));
+        return true;
+    default:
+        break;
+    }
+    return false;
+}
+
+bool readClients(Reader& from, Netcom::ClientInfoList* clients)
+{
+    quint64 count = 0;
+    if (!from.readVarUInt(&count))
+    {
+        return false;
+    }
+
+    // количество не превышает того, что может поместиться в оставшихся данных,
+    // поэтому повреждённый счётчик не приведёт к огромному выделению памяти.
+    clients->reserve(static_cast<std::size_t>(qMin(count, from.remaining() / ::minClientSize())));
+    for (quint64 i = 0; i < count; ++i)
+    {
+        clients->emplace_back();
+        Netcom::ClientInfo& each = clients->back();
+        if (   !readAddress(from, &each)
+            || !from.readPort(&each.port)
+            || !from.readBigEndian(&each.connected))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+Netcom::Message::Type typeFromTag(quint8 tag)
+{
+    Netcom::Message::Type type = static_cast<Netcom::Message::Type>(tag);
+    switch (type)
+    {
+    case Netcom::Message::Type::Subscribe:
+    case Netcom::Message::Type::Unsubscribe:
+    case Netcom::Message::Type::InfoRequest:
+    case Netcom::Message::Type::InfoResponse:
+    case Netcom::Message::Type::InfoNotModified:
+    case Netcom::Message::Type::InfoDelta:
+    case Netcom::Message::Type::InfoBegin:
+    case Netcom::Message::Type::InfoChunk:
+    case Netcom::Message::Type::InfoEnd:
+        return type;
+    default:
+        break;
+    }
+    return Netcom::Message::Type::Unknown;
+}
+
+}
+
+namespace Netcom
+{
+namespace BinaryCodec
+{
+
+bool isBinary(const QByteArray& raw)
+{
+    return (   !raw.isEmpty()
+            && static_cast<quint8>(raw.at(0)) == ::binaryMagic());
+}
+
+QByteArray encode(const Message& message)
+{
+    QByteArray result;
+    encodeInto(message, result);
+    return result;
+}
+
+void encodeInto(const Message& message, QByteArray& result)
+{
+    ::writeUInt8(result, ::binaryMagic());
+    ::writeUInt8(result, ::binaryVersion());
+    ::writeUInt8(result, static_cast<quint8>(message.type()));
+
+    if (message.backwardPort() > 0)
+    {
+        int field = ::beginField(result, ::BackwardPortTag);
+        ::writeVarUInt(result, message.backwardPort());
+        ::endField(result, field);
+    }
+
+    if (message.preferredCodec() != Message::Codec::Xml)
+    {
+        int field = ::beginField(result, ::PreferredCodecTag);
+        ::writeVarUInt(result, static_cast<quint64>(message.preferredCodec()));
+        ::endField(result, field);
+    }
+
+    if (message.acceptsChunks())
+    {
+        int field = ::beginField(result, ::AcceptsChunksTag);
+        ::writeUInt8(result, 1);
+        ::endField(result, field);
+    }
+
+    if (message.acceptsCompression())
+    {
+        int field = ::beginField(result, ::AcceptsCompressionTag);
+        ::writeUInt8(result, 1);
+        ::endField(result, field);
+    }
+
+    if (message.generation() > 0)
+    {
+        int field = ::beginField(result, ::GenerationTag);
+        ::writeVarUInt(result, message.generation());
+        ::endField(result, field);
+    }
+
+    if (message.isPushed())
+    {
+        int field = ::beginField(result, ::PushedTag);
+        ::writeUInt8(result, 1);
+        ::endField(result, field);
+    }
+
+    if (message.totalClients() > 0)
+    {
+        int field = ::beginField(result, ::TotalClientsTag);
+        ::writeVarUInt(result, message.totalClients());
+        ::endField(result, field);
+    }
+
+    if (!message.filter().isEmpty())
+    {
+        ::writeFilter(result, message.filter());
+    }
+
+    if (!message.clientsInfo().empty())
+    {
+        ::writeClients(result, ::ClientsTag, message.clientsInfo());
+    }
+
+    if (!message.removedClientsInfo().empty())
+    {
+        ::writeClients(result, ::RemovedClientsTag, message.removedClientsInfo());
+    }
+}
+
+bool decode(const QByteArray& raw, Message* message)
+{
+    Q_CHECK_PTR(message);
+
+    ::Reader input(raw.constData(), raw.constData() + raw.size());
+
+    quint8 magic = 0,
+           version = 0,
+           type = 0;
+    if (   !input.readUInt8(&magic)
+        || magic != ::binaryMagic()
+        || !input.readUInt8(&version)
+        || version != ::binaryVersion()
+        || !input.readUInt8(&type))
+    {
+        return false;
+    }
+    message->setType(::typeFromTag(type));
+
+    RosterFilter filter;
+    while (!input.atEnd())
+    {
+        quint8 tag = 0;
+        quint32 length = 0;
+        const char* data = nullptr;
+        if (   !input.readUInt8(&tag)
+            || !input.readBigEndian(&length)
+            || !input.readBytes(length, &data))
+        {
+            return false;
+        }
+
+        ::Reader field(data, data + length);
+        bool ok = true;
+        switch (tag)
+        {
+        case ::BackwardPortTag:
+            {
+                quint16 port = 0;
+                ok = field.readPort(&port);
+                message->setBackwardPort(port);
+            }
+            break;
+        case ::PreferredCodecTag:
+            {
+                quint64 codec = 0;
+                ok = field.readVarUInt(&codec);
+                message->setPreferredCodec(codec == static_cast<quint64>(Message::Codec::Binary) ? Message::Codec::Binary
+                                                                                                : Message::Codec::Xml);
+            }
+            break;
+        case ::ClientsTag:
+            {
+                ClientInfoList clients;
+                ok = ::readClients(field, &clients);
+                message->setClientsInfo(std::move(clients));
+            }
+            break;
+        case ::GenerationTag:
+            {
+                quint64 generation = 0;
+                ok = field.readVarUInt(&generation);
+                message->setGeneration(generation);
+            }
+            break;
+        case ::PushedTag:
+            {
+                quint8 pushed = 0;
+                ok = field.readUInt8(&pushed);
+                message->setPushed(pushed != 0);
+            }
+            break;
+        case ::AcceptsChunksTag:
+            {
+                quint8 accepts = 0;
+                ok = field.readUInt8(&accepts);
+                message->setAcceptsChunks(accepts != 0);
+            }
+            break;
+        case ::AcceptsCompressionTag:
+            {
+                quint8 accepts = 0;
+                ok = field.readUInt8(&accepts);
+                message->setAcceptsCompression(accepts != 0);
+            }
+            break;
+        case ::TotalClientsTag:
+            {
+                quint64 total = 0;
+                ok = field.readVarUInt(&total);
+                message->setTotalClients(total);
+            }
+            break;
+        case ::RemovedClientsTag:
+            {
+                ClientInfoList clients;
+                ok = ::readClients(field, &clients);
+                message->setRemovedClientsInfo(std::move(clients));
+            }
+            break;
+        case ::SinceTag:
+            ok = field.readBigEndian(&filter.since);
+            break;
+        case ::SubnetTag:
+            {
+                quint8 length = 0;
+                const char* network = nullptr;
+                ok = (   field.readUInt8(&length)
+                      && length <= 128
+                      && field.readBytes(sizeof(filter.network), &network));
+                if (ok)
+                {
+                    filter.setSubnetPrefix(reinterpret_cast<const quint8*>(network), length);
+                }
+            }
+            break;
+        case ::TransportTag:
+            {
+                quint8 transport = 0;
+                ok = field.readUInt8(&transport);
+                filter.transport = (transport <= static_cast<quint8>(RosterFilter::Transport::Udp) ? static_cast<RosterFilter::Transport>(transport)
+                                                                                                   : RosterFilter::Transport::Any);
+            }
+            break;
+        case ::OffsetTag:
+            ok = field.readUInt32(&filter.offset);
+            break;
+        case ::LimitTag:
+            ok = field.readUInt32(&filter.limit);
+            break;
+        default:
+            // поля новых версий формата пропускаются.
+            break;
+        }
+
+        if (!ok)
+        {
+            return false;
+        }
+    }
+    message->setFilter(filter);
+
+    return true;
+}
+
+} // BinaryCodec
+} // Netcom
@@ -0,0 +1,56 @@
+#ifndef NETCOM_BINARY_CODEC_H
+#define NETCOM_BINARY_CODEC_H
+
+class QByteArray;
+
+namespace Netcom
+{
+class Message;
+
+/**
+ * @namespace BinaryCodec
+ * @brief     Компактное двоичное кодирование тела сообщения Message.
+ *
+ * @note  Формат тела:
+ *        - quint8 - сигнатура (не может быть первым байтом XML-документа);
+ *        - quint8 - версия формата;
+ *        - quint8 - тип сообщения;
+ *        - последовательность полей: quint8 - тег, quint32 (big-endian) - длина, данные поля.
+ *        Поля с неизвестными тегами пропускаются, что позволяет расширять формат.
+ */
+namespace BinaryCodec
+{
+
+/**
+ * @brief  isBinary - проверяет, закодировано ли тело сообщения в двоичном формате.
+ * @param  raw - тело сообщения.
+ * @return true - если тело начинается с сигнатуры двоичного формата.
+ */
+bool isBinary(const QByteArray& raw);
+
+/**
+ * @brief  encode - кодирует сообщение в двоичный формат.
+ * @param  message - сообщение для кодирования.
+ * @return тело сообщения.
+ */
+QByteArray encode(const Message& message);
+
+/**
+ * @brief encodeInto - дописывает двоичное тело сообщения в конец буфера.
+ * @param message - сообщение для кодирования.
+ * @param to - буфер (его содержимое и зарезервированная ёмкость сохраняются).
+ */
+void encodeInto(const Message& message, QByteArray& to);
+
+/**
+ * @brief  decode - декодирует сообщение из двоичного формата.
+ * @param  raw - тело сообщения.
+ * @param  message - заполняемое сообщение.
+ * @return флаг успешности декодирования (false - если данные повреждены или обрезаны).
+ */
+bool decode(const QByteArray& raw, Message* message);
+
+} // BinaryCodec
+} // Netcom
+
+#endif // NETCOM_BINARY_CODEC_H
@@ -0,0 +1,126 @@
+#include "framedecoder.h"
+
+#include <QtEndian>
+
+#include "protocol.h"
+
+namespace
+{
+
+const int headerSize = sizeof(quint32);
+
+}
+
+namespace Netcom
+{
+
+void FrameDecoder::append(const QByteArray& bytes)
+{
+    if (m_corrupted)
+    {
+        return;
+    }
+    compact();
+    m_buffer.append(bytes);
+}
+
+void FrameDecoder::append(const char* data, int size)
+{
+    if (m_corrupted)
+    {
+        return;
+    }
+    compact();
+    m_buffer.append(data, size);
+}
+
+bool FrameDecoder::nextFrame(QByteArray* payload)
+{
+    Q_CHECK_PTR(payload);
+
+    if (pendingSize() < ::headerSize)
+    {
+        return false;
+    }
+
+    const char* header = m_buffer.constData() + m_cursor;
+    quint32 expectedSize = qFromBigEndian<quint32>(reinterpret_cast<const uchar*>(header));
+    const bool compressed = ((expectedSize & Message::compressedFrameFlag) != 0);
+    expectedSize &= ~Message::compressedFrameFlag;
+    if (expectedSize > Message::maxFrameSize)
+    {
+        // такой кадр не дожидаемся: иначе буфер рос бы до объявленной длины.
+        m_buffer.clear();
+        m_cursor = 0;
+        m_corrupted = true;
+        return false;
+    }
+    if (static_cast<quint32>(pendingSize() - ::headerSize) < expectedSize)
+    {
+        return false;
+    }
+
+    m_cursor += ::headerSize + static_cast<int>(expectedSize);
+    if (compressed)
+    {
+        // повреждённое сжатое тело передаётся пустым и разбирается как сообщение неизвестного типа.
+        if (!Message::uncompressPayload(header + ::headerSize, static_cast<int>(expectedSize), payload))
+        {
+            payload->clear();
+        }
+        return true;
+    }
+    *payload = QByteArray::fromRawData(header + ::headerSize, static_cast<int>(expectedSize));
+    return true;
+}
+
+bool FrameDecoder::next(Message* message)
+{
+    Q_CHECK_PTR(message);
+
+    QByteArray payload;
+    if (!nextFrame(&payload))
+    {
+        return false;
+    }
+
+    *message = Message::parse(payload);
+    return true;
+}
+
+void FrameDecoder::clear()
+{
+    m_buffer.clear();
+    m_cursor = 0;
+    m_corrupted = false;
+}
+
+bool FrameDecoder::isCorrupted() const
+{
+    return m_corrupted;
+}
+
+int FrameDecoder::pendingSize() const
+{
+    return m_buffer.size() - m_cursor;
+}
+
+void FrameDecoder::compact()
+{
+    if (m_cursor == 0)
+    {
+        return;
+    }
+
+    if (m_cursor == m_buffer.size())
+    {
+        clear();
+    }
+    else if (m_cursor >= pendingSize())
+    {
+        m_buffer.remove(0, m_cursor);
+        m_cursor = 0;
+    }
+}
+
+} // Netcom
@@ -0,0 +1,80 @@
+#ifndef NETCOM_FRAME_DECODER_H
+#define NETCOM_FRAME_DECODER_H
+
+#include <QByteArray>
+
+namespace Netcom
+{
+class Message;
+
+/**
+ * @class FrameDecoder
+ * @brief Накапливает принятые байты и выделяет из них кадры протокола (quint32 размер тела + тело).
+ *
+ * @note  Разобранные кадры не удаляются из буфера сразу: декодер сдвигает позицию чтения
+ *        и сжимает буфер только когда прочитанная часть становится не меньше непрочитанной,
+ *        поэтому поток из множества кадров обрабатывается за линейное время.
+ *        Кадр с длиной больше Message::maxFrameSize не накапливается: буфер очищается,
+ *        и декодер считается повреждённым до вызова clear(). Тело кадра с флагом
+ *        Message::compressedFrameFlag восстанавливается при выделении.
+ */
+class FrameDecoder
+{
+public:
+    FrameDecoder() = default;
+
+    /**
+     * @brief append - добавляет принятые байты в буфер.
+     * @param bytes - принятые байты.
+     *
+     * @note  Делает недействительными тела кадров, ранее полученные через nextFrame().
+     */
+    void append(const QByteArray& bytes);
+    void append(const char* data, int size);
+
+    /**
+     * @brief  nextFrame - выделяет тело очередного полностью принятого кадра.
+     * @param  payload - тело кадра. Ссылается на внутренний буфер без копирования
+     *                   и остаётся действительным до следующего вызова append() или clear()
+     *                   (сжатое тело восстанавливается в отдельный массив).
+     * @return true - если кадр выделен, false - если полный кадр ещё не принят или поток повреждён.
+     */
+    bool nextFrame(QByteArray* payload);
+
+    /**
+     * @brief  next - выделяет и разбирает очередной полностью принятый кадр.
+     * @param  message - разобранное сообщение.
+     * @return true - если кадр выделен, false - если полный кадр ещё не принят.
+     */
+    bool next(Message* message);
+
+    /**
+     * @brief clear - очищает буфер и сбрасывает признак повреждения потока.
+     */
+    void clear();
+
+    /**
+     * @brief  isCorrupted - проверяет, был ли принят заголовок кадра с недопустимой длиной.
+     * @return true - если поток повреждён (принимаемые байты отбрасываются до вызова clear()).
+     */
+    bool isCorrupted() const;
+
+    /**
+     * @brief  pendingSize - возвращает количество принятых, но ещё не разобранных байт.
+     * @return количество байт.
+     */
+    int pendingSize() const;
+
+private:
+    void compact();
+
+private:
+    QByteArray m_buffer; //!< принятые байты.
+    int m_cursor = 0;    //!< позиция начала первого неразобранного кадра.
+    bool m_corrupted = false; //!< принят заголовок кадра с недопустимой длиной.
+
+};
+
+} // Netcom
+
+#endif // NETCOM_FRAME_DECODER_H
@@ -1,4 +1,7 @@
 #include "protocol.h"
+#include "binarycodec.h"
+
+#include <cstring>
 
 #include <QCoreApplication>
 #include <QByteArray>
@@ -6,23 +9,187 @@
 #include <QDataStream>
 #include <QDomDocument>
 #include <QDomElement>
-#include <QMap>
+#include <QHash>
+#include <QHostAddress>
+#include <QPair>
+#include <QtEndian>
+#include <QXmlStreamReader>
 
 namespace
 {
 
 const QString dateTimeFormat() { return "hh:mm:ss dd-MM-yyyy"; }
 
-const QMap<Netcom::Message::Type, QString>& messageTypes()
+const QString binaryCodecName() { return "binary"; }
+
+void appendClients(QDomDocument& doc, QDomElement& parent, const QString& tagName, const Netcom::ClientInfoList& info)
+{
+    QDomElement clients = doc.createElement(tagName);
+    parent.appendChild(clients);
+
+    for (const Netcom::ClientInfo& each : info)
+    {
+        QDomElement eachClient = doc.createElement("client");
+        eachClient.setAttribute("address", each.addressString());
+        eachClient.setAttribute("port", each.port);
+        eachClient.setAttribute("datetime", each.datetime().toString(::dateTimeFormat()));
+        if (each.connected != Netcom::ClientInfo::invalidTime)
+        {
+            eachClient.setAttribute("msecs", each.connected);
+        }
+        clients.appendChild(eachClient);
+    }
+}
+
+void appendFilter(QDomDocument& doc, QDomElement& parent, const Netcom::RosterFilter& filter)
+{
+    QDomElement element = doc.createElement("filter");
+    if (filter.since != Netcom::ClientInfo::invalidTime)
+    {
+        element.setAttribute("since", filter.since);
+    }
+    if (filter.prefixLength >= 0)
+    {
+        element.setAttribute("subnet", filter.subnet());
+    }
+    if (filter.transport != Netcom::RosterFilter::Transport::Any)
+    {
+        element.setAttribute("transport", filter.transport == Netcom::RosterFilter::Transport::Tcp ? "tcp"
+                                                                                                   : "udp");
+    }
+    if (filter.offset > 0)
+    {
+        element.setAttribute("offset", filter.offset);
+    }
+    if (filter.limit > 0)
+    {
+        element.setAttribute("limit", filter.limit);
+    }
+    parent.appendChild(element);
+}
+
+Netcom::RosterFilter parseFilter(const QXmlStreamAttributes& attributes)
 {
-    static const QMap<Netcom::Message::Type, QString> types({
-                                                                { Netcom::Message::Type::Subscribe,    "subscribe"     },
-                                                                { Netcom::Message::Type::Unsubscribe,  "unsubscribe"   },
-                                                                { Netcom::Message::Type::InfoRequest,  "info_request"  },
-                                                                { Netcom::Message::Type::InfoResponse, "info_response" },
-                                                                { Netcom::Message::Type::Unknown,      "unknown"       }
-                                                            });
-    return types;
+    Netcom::RosterFilter result;
+
+    bool ok = false;
+    qint64 since = attributes.value("since").toLongLong(&ok);
+    if (ok)
+    {
+        result.since = since;
+    }
+    // неверно заданная подсеть не ограничивает список.
+    result.setSubnet(attributes.value("subnet").toString());
+
+    const QStringRef transport = attributes.value("transport");
+    if (transport == QLatin1String("tcp"))
+    {
+        result.transport = Netcom::RosterFilter::Transport::Tcp;
+    }
+    else if (transport == QLatin1String("udp"))
+    {
+        result.transport = Netcom::RosterFilter::Transport::Udp;
+    }
+
+    result.offset = attributes.value("offset").toUInt();
+    result.limit = attributes.value("limit").toUInt();
+    return result;
+}
+
+/**
+ * @brief  connectedMsecs - возвращает время подключения клиента из атрибутов элемента client.
+ * @param  attributes - атрибуты элемента.
+ * @return время подключения, мс UTC от начала эпохи.
+ *
+ * @note   Точное время (msecs) передаётся новыми версиями и используется, если оно есть;
+ *         строка datetime (без миллисекунд и часового пояса) сохраняется для прежних версий.
+ */
+qint64 connectedMsecs(const QXmlStreamAttributes& attributes)
+{
+    bool ok = false;
+    qint64 msecs = attributes.value("msecs").toLongLong(&ok);
+    if (ok)
+    {
+        return msecs;
+    }
+
+    QDateTime datetime = QDateTime::fromString(attributes.value("datetime").toString(), ::dateTimeFormat());
+    return (datetime.isValid() ? datetime.toMSecsSinceEpoch()
+                               : Netcom::ClientInfo::invalidTime);
+}
+
+/**
+ * @brief Названия типов сообщений, индексируемые значением Message::Type.
+ */
+constexpr const char* messageTypeNames[] = { "unknown",
+                                             "subscribe",
+                                             "unsubscribe",
+                                             "info_request",
+                                             "info_response",
+                                             "info_not_modified",
+                                             "info_delta",
+                                             "info_begin",
+                                             "info_chunk",
+                                             "info_end"
+                                           };
+
+constexpr int messageTypesCount = static_cast<int>(sizeof(messageTypeNames) / sizeof(messageTypeNames[0]));
+
+static_assert(messageTypesCount == static_cast<int>(Netcom::Message::Type::InfoEnd) + 1,
+              "messageTypeNames must list every Message::Type");
+
+/**
+ * @brief  typeFromName - преобразует название типа в значение Message::Type без выделения памяти.
+ * @param  name - название типа (например, значение атрибута из QXmlStreamReader).
+ * @return значение Type (Type::Unknown - если название неизвестно).
+ *
+ * @note   Длина определяет кандидата, и для большинства названий достаточно одного сравнения.
+ *         Названия длиной 10 (info_delta, info_begin, info_chunk) различаются по символу с индексом 5.
+ */
+Netcom::Message::Type typeFromName(const QStringRef& name)
+{
+    Netcom::Message::Type candidate = Netcom::Message::Type::Unknown;
+    switch (name.size())
+    {
+    case 8:
+        candidate = Netcom::Message::Type::InfoEnd;
+        break;
+    case 9:
+        candidate = Netcom::Message::Type::Subscribe;
+        break;
+    case 10:
+        switch (name.at(5).unicode())
+        {
+        case 'd':
+            candidate = Netcom::Message::Type::InfoDelta;
+            break;
+        case 'b':
+            candidate = Netcom::Message::Type::InfoBegin;
+            break;
+        case 'c':
+            candidate = Netcom::Message::Type::InfoChunk;
+            break;
+        default:
+            return Netcom::Message::Type::Unknown;
+        }
+        break;
+    case 11:
+        candidate = Netcom::Message::Type::Unsubscribe;
+        break;
+    case 12:
+        candidate = Netcom::Message::Type::InfoRequest;
+        break;
+    case 13:
+        candidate = Netcom::Message::Type::InfoResponse;
+        break;
+    case 17:
+        candidate = Netcom::Message::Type::InfoNotModified;
+        break;
+    default:
+        return Netcom::Message::Type::Unknown;
+    }
+    return (name == QLatin1String(::messageTypeNames[static_cast<int>(candidate)]) ? candidate
+                                                                                    : Netcom::Message::Type::Unknown);
 }
 
 }
@@ -30,12 +197,77 @@ const QMap<Netcom::Message::Type, QString>& messageTypes()
 namespace Netcom
 {
 
+void toMappedAddress(const QHostAddress& address, quint8* to)
+{
+    std::memset(to, 0, 16);
+
+    bool ipv4 = false;
+    quint32 raw = address.toIPv4Address(&ipv4);
+    if (ipv4)
+    {
+        to[10] = 0xFF;
+        to[11] = 0xFF;
+        qToBigEndian<quint32>(raw, to + 12);
+    }
+    else if (address.protocol() == QAbstractSocket::IPv6Protocol)
+    {
+        Q_IPV6ADDR ipv6 = address.toIPv6Address();
+        std::memcpy(to, ipv6.c, sizeof(ipv6.c));
+    }
+}
+
+QHostAddress fromMappedAddress(const quint8* from)
+{
+    static const quint8 ipv4Prefix[12] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xFF, 0xFF };
+    if (std::memcmp(from, ipv4Prefix, sizeof(ipv4Prefix)) == 0)
+    {
+        return QHostAddress(qFromBigEndian<quint32>(from + 12));
+    }
+    return QHostAddress(from);
+}
+
+const qint64 ClientInfo::invalidTime;
+
+ClientInfo::ClientInfo(const QHostAddress& a, quint16 p, qint64 connectedMsecs) :
+    connected(connectedMsecs),
+    port(p)
+{
+    setHostAddress(a);
+}
+
 ClientInfo::ClientInfo(const QString& a, quint16 p, const QDateTime& d) :
-    address(a),
-    port(p),
-    datetime(d)
+    connected(d.isValid() ? d.toMSecsSinceEpoch()
+                          : invalidTime),
+    port(p)
+{
+    setHostAddress(QHostAddress(a));
+}
+
+QHostAddress ClientInfo::hostAddress() const
+{
+    return fromMappedAddress(address);
+}
+
+void ClientInfo::setHostAddress(const QHostAddress& a)
+{
+    toMappedAddress(a, address);
+}
+
+QString ClientInfo::addressString() const
+{
+    return hostAddress().toString();
+}
+
+bool ClientInfo::isIPv4() const
 {
+    static const quint8 ipv4Prefix[12] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xFF, 0xFF };
+    return (std::memcmp(address, ipv4Prefix, sizeof(ipv4Prefix)) == 0);
+}
 
+QDateTime ClientInfo::datetime() const
+{
+    return (connected != invalidTime ? QDateTime::fromMSecsSinceEpoch(connected)
+                                     : QDateTime());
 }
 
 bool ClientInfo::operator== (const ClientInfo& rhs) const
@@ -45,9 +277,9 @@ bool ClientInfo::operator== (const ClientInfo& rhs) const
         return true;
     }
 
-    return (   address == rhs.address
+    return (   connected == rhs.connected
             && port == rhs.port
-            && datetime == rhs.datetime);
+            && std::memcmp(address, rhs.address, sizeof(address)) == 0);
 }
 
 bool ClientInfo::operator!= (const ClientInfo& rhs) const
@@ -55,6 +287,144 @@ bool ClientInfo::operator!= (const ClientInfo& rhs) const
     return !(*this == rhs);
 }
 
+uint qHash(const ClientInfo& key, uint seed)
+{
+    return (::qHash(QByteArray::fromRawData(reinterpret_cast<const char*>(key.address), sizeof(key.address)), seed) ^ ::qHash(key.port, seed) ^ ::qHash(key.connected, seed));
+}
+
+bool RosterFilter::isEmpty() const
+{
+    return (   since == ClientInfo::invalidTime
+            && prefixLength < 0
+            && transport == Transport::Any
+            && offset == 0
+            && limit == 0);
+}
+
+bool RosterFilter::setSubnet(const QString& subnet)
+{
+    const QString trimmed = subnet.trimmed();
+    if (trimmed.isEmpty())
+    {
+        setSubnetPrefix(nullptr, -1);
+        return true;
+    }
+
+    QPair<QHostAddress, int> parsed;
+    if (trimmed.contains('/'))
+    {
+        parsed = QHostAddress::parseSubnet(trimmed);
+    }
+    else
+    {
+        parsed.first = QHostAddress(trimmed);
+        parsed.second = (parsed.first.protocol() == QAbstractSocket::IPv4Protocol ? 32
+                                                                                  : 128);
+    }
+    if (   parsed.first.isNull()
+        || parsed.second < 0)
+    {
+        return false;
+    }
+
+    // длина префикса IPv4 отсчитывается от начала IPv4-mapped адреса (::ffff:0:0/96).
+    ClientInfo mapped;
+    mapped.setHostAddress(parsed.first);
+    setSubnetPrefix(mapped.address, parsed.first.protocol() == QAbstractSocket::IPv4Protocol ? parsed.second + 96
+                                                                                            : parsed.second);
+    return true;
+}
+
+QString RosterFilter::subnet() const
+{
+    if (prefixLength < 0)
+    {
+        return QString::null;
+    }
+
+    ClientInfo holder;
+    std::memcpy(holder.address, network, sizeof(network));
+    if (   holder.isIPv4()
+        && prefixLength >= 96)
+    {
+        return QString("%1/%2").arg(holder.addressString()).arg(prefixLength - 96);
+    }
+    return QString("%1/%2").arg(QHostAddress(network).toString()).arg(prefixLength);
+}
+
+void RosterFilter::setSubnetPrefix(const quint8* address, int length)
+{
+    std::memset(network, 0, sizeof(network));
+    if (   address == nullptr
+        || length < 0)
+    {
+        prefixLength = -1;
+        return;
+    }
+
+    prefixLength = qMin(length, 128);
+    const int bytes = prefixLength / 8;
+    const int bits = prefixLength % 8;
+    std::memcpy(network, address, static_cast<std::size_t>(bytes));
+    if (bits > 0)
+    {
+        network[bytes] = address[bytes] & static_cast<quint8>(0xFF << (8 - bits));
+    }
+}
+
+void RosterFilter::subnetRange(quint8* first, quint8* last) const
+{
+    std::memcpy(first, network, sizeof(network));
+    std::memcpy(last, network, sizeof(network));
+    for (int bit = qMax(prefixLength, 0); bit < 128; ++bit)
+    {
+        last[bit / 8] |= static_cast<quint8>(0x80 >> (bit % 8));
+    }
+}
+
+bool RosterFilter::accepts(const ClientInfo& client) const
+{
+    if (   since != ClientInfo::invalidTime
+        && (client.connected == ClientInfo::invalidTime || client.connected < since))
+    {
+        return false;
+    }
+
+    if (prefixLength >= 0)
+    {
+        const int bytes = prefixLength / 8;
+        const int bits = prefixLength % 8;
+        if (std::memcmp(client.address, network, static_cast<std::size_t>(bytes)) != 0)
+        {
+            return false;
+        }
+        if (   bits > 0
+            && (client.address[bytes] & static_cast<quint8>(0xFF << (8 - bits))) != network[bytes])
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool RosterFilter::operator== (const RosterFilter& rhs) const
+{
+    return (   since == rhs.since
+            && prefixLength == rhs.prefixLength
+            && std::memcmp(network, rhs.network, sizeof(network)) == 0
+            && transport == rhs.transport
+            && offset == rhs.offset
+            && limit == rhs.limit);
+}
+
+bool RosterFilter::operator!= (const RosterFilter& rhs) const
+{
+    return !(*this == rhs);
+}
+
+const quint32 Message::maxFrameSize;
+const quint32 Message::compressedFrameFlag;
+
 Message::Message(Type type) :
     m_type(type)
 {
@@ -81,52 +451,250 @@ void Message::setBackwardPort(quint16 port)
     m_backwardPort = port;
 }
 
-const QList<ClientInfo>& Message::clientsInfo() const
+Message::Codec Message::codec() const
+{
+    return m_codec;
+}
+
+void Message::setCodec(Codec codec)
+{
+    m_codec = codec;
+}
+
+Message::Codec Message::preferredCodec() const
+{
+    return m_preferredCodec;
+}
+
+void Message::setPreferredCodec(Codec codec)
+{
+    m_preferredCodec = codec;
+}
+
+quint64 Message::generation() const
+{
+    return m_generation;
+}
+
+void Message::setGeneration(quint64 generation)
+{
+    m_generation = generation;
+}
+
+bool Message::isPushed() const
+{
+    return m_pushed;
+}
+
+void Message::setPushed(bool pushed)
+{
+    m_pushed = pushed;
+}
+
+bool Message::acceptsChunks() const
+{
+    return m_acceptsChunks;
+}
+
+void Message::setAcceptsChunks(bool accepts)
+{
+    m_acceptsChunks = accepts;
+}
+
+bool Message::acceptsCompression() const
+{
+    return m_acceptsCompression;
+}
+
+void Message::setAcceptsCompression(bool accepts)
+{
+    m_acceptsCompression = accepts;
+}
+
+quint64 Message::totalClients() const
+{
+    return m_totalClients;
+}
+
+void Message::setTotalClients(quint64 total)
+{
+    m_totalClients = total;
+}
+
+const RosterFilter& Message::filter() const
+{
+    return m_filter;
+}
+
+void Message::setFilter(const RosterFilter& filter)
+{
+    m_filter = filter;
+}
+
+const ClientInfoList& Message::clientsInfo() const
 {
     return m_info;
 }
 
-void Message::setClientsInfo(const QList<ClientInfo>& info)
+void Message::setClientsInfo(const ClientInfoList& info)
 {
     m_info = info;
 }
 
+void Message::setClientsInfo(ClientInfoList&& info)
+{
+    m_info = std::move(info);
+}
+
+ClientInfoList Message::takeClientsInfo()
+{
+    ClientInfoList result;
+    result.swap(m_info);
+    return result;
+}
+
+void Message::reserveClientsInfo(std::size_t count)
+{
+    m_info.reserve(count);
+}
+
 void Message::addClientInfo(const ClientInfo& info)
 {
-    m_info.append(info);
+    m_info.push_back(info);
+}
+
+void Message::addClientInfo(ClientInfo&& info)
+{
+    m_info.push_back(std::move(info));
 }
 
 void Message::resetClientsInfo()
 {
     m_info.clear();
+    m_removed.clear();
+}
+
+const ClientInfoList& Message::removedClientsInfo() const
+{
+    return m_removed;
+}
+
+void Message::setRemovedClientsInfo(const ClientInfoList& info)
+{
+    m_removed = info;
+}
+
+void Message::setRemovedClientsInfo(ClientInfoList&& info)
+{
+    m_removed = std::move(info);
+}
+
+ClientInfoList Message::takeRemovedClientsInfo()
+{
+    ClientInfoList result;
+    result.swap(m_removed);
+    return result;
+}
+
+void Message::addRemovedClientInfo(const ClientInfo& info)
+{
+    m_removed.push_back(info);
+}
+
+void Message::addRemovedClientInfo(ClientInfo&& info)
+{
+    m_removed.push_back(std::move(info));
 }
 
 QByteArray Message::serialize() const
+{
+    switch (m_codec)
+    {
+    case Codec::Binary:
+        return BinaryCodec::encode(*this);
+    case Codec::Xml:
+    default:
+        break;
+    }
+    return serializeXml();
+}
+
+int Message::serializeInto(QByteArray& to) const
+{
+    const int position = to.size();
+    to.resize(position + static_cast<int>(sizeof(quint32)));
+
+    switch (m_codec)
+    {
+    case Codec::Binary:
+        BinaryCodec::encodeInto(*this, to);
+        break;
+    case Codec::Xml:
+    default:
+        to.append(serializeXml());
+        break;
+    }
+
+    const int size = to.size() - position;
+    qToBigEndian<quint32>(static_cast<quint32>(size - static_cast<int>(sizeof(quint32))),
+                          reinterpret_cast<uchar*>(to.data() + position));
+    return size;
+}
+
+QByteArray Message::serializeXml() const
 {
     QDomDocument doc("netcom");
     QDomElement root = doc.createElement("netcom");
     doc.appendChild(root);
     QDomElement message = doc.createElement("message");
     message.setAttribute("type", typeToString(m_type));
+    if (m_generation > 0)
+    {
+        message.setAttribute("generation", m_generation);
+    }
+    if (m_pushed)
+    {
+        message.setAttribute("push", 1);
+    }
+    if (m_totalClients > 0)
+    {
+        message.setAttribute("total", m_totalClients);
+    }
+    if (!m_filter.isEmpty())
+    {
+        ::appendFilter(doc, message, m_filter);
+    }
     root.appendChild(message);
-    if (!m_info.isEmpty())
+    if (!m_info.empty())
     {
-        QDomElement clients = doc.createElement("clients");
-        message.appendChild(clients);
-
-        for (const ClientInfo& each : m_info)
-        {
-            QDomElement eachClient = doc.createElement("client");
-            eachClient.setAttribute("address", each.address);
-            eachClient.setAttribute("port", each.port);
-            eachClient.setAttribute("datetime", each.datetime.toString(::dateTimeFormat()));
-            clients.appendChild(eachClient);
-        }
+        ::appendClients(doc, message, "clients", m_info);
     }
-    if (m_backwardPort > 0)
+    if (!m_removed.empty())
+    {
+        ::appendClients(doc, message, "removed", m_removed);
+    }
+    if (   m_backwardPort > 0
+        || m_preferredCodec != Codec::Xml
+        || m_acceptsChunks
+        || m_acceptsCompression)
     {
         QDomElement options = doc.createElement("options");
-        options.setAttribute("backward_port", m_backwardPort);
+        if (m_backwardPort > 0)
+        {
+            options.setAttribute("backward_port", m_backwardPort);
+        }
+        if (m_preferredCodec == Codec::Binary)
+        {
+            options.setAttribute("codec", ::binaryCodecName());
+        }
+        if (m_acceptsChunks)
+        {
+            options.setAttribute("chunked", 1);
+        }
+        if (m_acceptsCompression)
+        {
+            options.setAttribute("compressed", 1);
+        }
         root.appendChild(options);
     }
 
@@ -141,78 +709,18 @@ Message Message::parse(const QByteArray& raw, bool *ok)
     }
 
     Message result;
-
-    QDomDocument doc;
-    QString errorMessage;
-    int errorLine = 0,
-        errorColumn = 0;
-    if (doc.setContent(raw, &errorMessage, &errorLine, &errorColumn))
+    if (BinaryCodec::isBinary(raw))
     {
-        QDomElement root = doc.documentElement();
-        QDomNodeList messageChildren = root.elementsByTagName("message");
-        for (int i = 0, isz = messageChildren.size(); i < isz; ++i)
+        result.m_codec = Codec::Binary;
+        if (!BinaryCodec::decode(raw, &result))
         {
-            if (!messageChildren.item(i).isElement())
-            {
-                continue;
-            }
-
-            QDomElement el = messageChildren.item(i).toElement();
-            if (el.hasAttribute("type"))
-            {
-                result.m_type = typeFromString(el.attribute("type"));
-            }
-
-            if (!el.hasChildNodes())
-            {
-                continue;
-            }
-            QDomNodeList clientsChildren = el.elementsByTagName("clients");
-            for (int j = 0, jsz = clientsChildren.size(); j < jsz; ++j)
-            {
-                if (!clientsChildren.item(j).isElement())
-                {
-                    continue;
-                }
-                QDomNodeList clientChildren = clientsChildren.item(j).toElement().elementsByTagName("client");
-                for (int k = 0, ksz = clientChildren.size(); k < ksz; ++k)
-                {
-                    if (!clientChildren.item(k).isElement())
-                    {
-                        continue;
-                    }
-                    QDomElement client = clientChildren.item(k).toElement();
-                    if (   client.hasAttribute("address")
-                        && client.hasAttribute("port")
-                        && client.hasAttribute("datetime"))
-                    {
-                        result.addClientInfo(ClientInfo(client.attribute("address"),
-                                                        client.attribute("port").toUInt(),
-                                                        QDateTime::fromString(client.attribute("datetime"), ::dateTimeFormat())));
-                    }
-                }
-            }
-        }
-        QDomNodeList optionsChildren = root.elementsByTagName("options");
-        for (int i = 0, sz = optionsChildren.size(); i < sz; ++i)
-        {
-            if (!optionsChildren.item(i).isElement())
-            {
-                continue;
-            }
-            QDomElement el = optionsChildren.item(i).toElement();
-            if (el.hasAttribute("backward_port"))
-            {
-                result.m_backwardPort = el.attribute("backward_port").toUInt();
-            }
+            qWarning() << qApp->tr("Message parsing error: malformed binary message");
+            result = Message();
         }
     }
     else
     {
-        qWarning() << qApp->tr("Message parsing error: %1 in line %2, column %3")
-                      .arg(errorMessage)
-                      .arg(errorLine)
-                      .arg(errorColumn);
+        result = parseXml(raw);
     }
 
     if (ok != nullptr)
@@ -223,6 +731,11 @@ Message Message::parse(const QByteArray& raw, bool *ok)
         case Type::Unsubscribe:
         case Type::InfoRequest:
         case Type::InfoResponse:
+        case Type::InfoNotModified:
+        case Type::InfoDelta:
+        case Type::InfoBegin:
+        case Type::InfoChunk:
+        case Type::InfoEnd:
             *ok = true;
             break;
         default:
@@ -233,25 +746,194 @@ Message Message::parse(const QByteArray& raw, bool *ok)
     return result;
 }
 
+QByteArray Message::compressFrame(const QByteArray& frame, int threshold)
+{
+    const int headerSize = static_cast<int>(sizeof(quint32));
+    const int bodySize = frame.size() - headerSize;
+    if (   bodySize <= 0
+        || bodySize < threshold
+        || (qFromBigEndian<quint32>(reinterpret_cast<const uchar*>(frame.constData())) & compressedFrameFlag) != 0)
+    {
+        return frame;
+    }
+
+    const QByteArray body = qCompress(reinterpret_cast<const uchar*>(frame.constData() + headerSize), bodySize);
+    if (body.size() >= bodySize)
+    {
+        return frame;
+    }
+
+    QByteArray result(headerSize, '\0');
+    qToBigEndian<quint32>(static_cast<quint32>(body.size()) | compressedFrameFlag,
+                          reinterpret_cast<uchar*>(result.data()));
+    result.append(body);
+    return result;
+}
+
+bool Message::uncompressPayload(const char* data, int size, QByteArray* payload)
+{
+    Q_CHECK_PTR(payload);
+
+    if (size < static_cast<int>(sizeof(quint32)))
+    {
+        return false;
+    }
+
+    // qCompress записывает размер исходных данных перед сжатыми, и qUncompress выделяет память по нему заранее.
+    const quint32 expectedSize = qFromBigEndian<quint32>(reinterpret_cast<const uchar*>(data));
+    if (expectedSize > maxFrameSize)
+    {
+        return false;
+    }
+
+    QByteArray result = qUncompress(reinterpret_cast<const uchar*>(data), size);
+    if (static_cast<quint32>(result.size()) != expectedSize)
+    {
+        return false;
+    }
+
+    *payload = result;
+    return true;
+}
+
+Message Message::parseXml(const QByteArray& raw)
+{
+    Message result;
+
+    // один проход по документу: элементы <message>, <clients> и <options> ищутся
+    // среди потомков корневого элемента, так же как это делал разбор через QDomDocument.
+    QXmlStreamReader reader(raw);
+    int depth = 0;
+    int openedMessages = 0;
+    int openedClients = 0;
+    int openedRemoved = 0;
+    while (!reader.atEnd())
+    {
+        switch (reader.readNext())
+        {
+        case QXmlStreamReader::StartElement:
+            {
+                ++depth;
+                if (depth == 1)
+                {
+                    break;
+                }
+
+                const QStringRef name = reader.qualifiedName();
+                const QXmlStreamAttributes attributes = reader.attributes();
+                if (name == QLatin1String("message"))
+                {
+                    ++openedMessages;
+                    if (attributes.hasAttribute("type"))
+                    {
+                        result.m_type = ::typeFromName(attributes.value("type"));
+                    }
+                    if (attributes.hasAttribute("generation"))
+                    {
+                        result.m_generation = attributes.value("generation").toULongLong();
+                    }
+                    result.m_pushed = (attributes.value("push") == QLatin1String("1"));
+                    if (attributes.hasAttribute("total"))
+                    {
+                        result.m_totalClients = attributes.value("total").toULongLong();
+                    }
+                }
+                else if (   name == QLatin1String("clients")
+                         && openedMessages > 0)
+                {
+                    ++openedClients;
+                }
+                else if (   name == QLatin1String("removed")
+                         && openedMessages > 0)
+                {
+                    ++openedRemoved;
+                }
+                else if (   name == QLatin1String("client")
+                         && (openedClients > 0 || openedRemoved > 0))
+                {
+                    if (   attributes.hasAttribute("address")
+                        && attributes.hasAttribute("port")
+                        && (attributes.hasAttribute("msecs") || attributes.hasAttribute("datetime")))
+                    {
+                        ClientInfoList& target = (openedClients > 0 ? result.m_info
+                                                                    : result.m_removed);
+                        target.emplace_back(QHostAddress(attributes.value("address").toString()),
+                                            static_cast<quint16>(attributes.value("port").toUInt()),
+                                            ::connectedMsecs(attributes));
+                    }
+                }
+                else if (   name == QLatin1String("filter")
+                         && openedMessages > 0)
+                {
+                    result.m_filter = ::parseFilter(attributes);
+                }
+                else if (name == QLatin1String("options"))
+                {
+                    if (attributes.hasAttribute("backward_port"))
+                    {
+                        result.m_backwardPort = attributes.value("backward_port").toUInt();
+                    }
+                    if (attributes.value("codec") == ::binaryCodecName())
+                    {
+                        result.m_preferredCodec = Codec::Binary;
+                    }
+                    result.m_acceptsChunks = (attributes.value("chunked") == QLatin1String("1"));
+                    result.m_acceptsCompression = (attributes.value("compressed") == QLatin1String("1"));
+                }
+            }
+            break;
+        case QXmlStreamReader::EndElement:
+            {
+                --depth;
+
+                const QStringRef name = reader.qualifiedName();
+                if (   name == QLatin1String("clients")
+                    && openedClients > 0)
+                {
+                    --openedClients;
+                }
+                else if (   name == QLatin1String("removed")
+                         && openedRemoved > 0)
+                {
+                    --openedRemoved;
+                }
+                else if (   name == QLatin1String("message")
+                         && openedMessages > 0)
+                {
+                    --openedMessages;
+                }
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    if (reader.hasError())
+    {
+        qWarning() << qApp->tr("Message parsing error: %1 in line %2, column %3")
+                      .arg(reader.errorString())
+                      .arg(reader.lineNumber())
+                      .arg(reader.columnNumber());
+        return Message();
+    }
+
+    return result;
+}
+
 QString Message::typeToString(Type type)
 {
-    if (::messageTypes().contains(type))
+    int index = static_cast<int>(type);
+    if (index < 0 || index >= ::messageTypesCount)
     {
-        return ::messageTypes()[type];
+        index = static_cast<int>(Message::Type::Unknown);
     }
-    return ::messageTypes()[Message::Type::Unknown];
+    return QLatin1String(::messageTypeNames[index]);
 }
 
 Message::Type Message::typeFromString(const QString& type)
 {
-    auto founded = std::find_if(::messageTypes().cbegin(),
-                                ::messageTypes().cend(),
-                                [&type](const QString& each)
-                                {
-                                    return type == each;
-                                });
-    return (founded != ::messageTypes().cend() ? founded.key()
-                                               : Message::Type::Unknown);
+    return ::typeFromName(QStringRef(&type));
 }
 
 QDataStream& operator<< (QDataStream& to, const Message& from)
@@ -268,8 +950,24 @@ QDataStream& operator>> (QDataStream& from, Message& to)
 {
     quint32 size = 0;
     from >> size;
+    const bool compressed = ((size & Message::compressedFrameFlag) != 0);
+    size &= ~Message::compressedFrameFlag;
+    if (size > Message::maxFrameSize)
+    {
+        // память под тело выделяется заранее, поэтому заведомо неверная длина не должна до этого дойти.
+        from.setStatus(QDataStream::ReadCorruptData);
+        to = Message();
+        return from;
+    }
     QByteArray raw(size, '\0');
     from.readRawData(raw.data(), size);
+    if (   compressed
+        && !Message::uncompressPayload(raw.constData(), raw.size(), &raw))
+    {
+        from.setStatus(QDataStream::ReadCorruptData);
+        to = Message();
+        return from;
+    }
     to = Message::parse(raw);
 
     return from;
@@ -1,32 +1,165 @@
 #ifndef NETCOM_PROTOCOL_H
 #define NETCOM_PROTOCOL_H
 
+#include <limits>
+#include <utility>
+#include <vector>
+
 #include <QDateTime>
-#include <QList>
 #include <QString>
 
 class QByteArray;
 class QDataStream;
+class QHostAddress;
 
 namespace Netcom
 {
+/**
+ * @brief toMappedAddress - записывает адрес в 16-байтовом виде (network byte order), в котором его хранит ClientInfo.
+ * @param address - адрес.
+ * @param to - 16 байт: IPv4 - в виде IPv4-mapped IPv6 (::ffff:a.b.c.d), не ip-адрес - неопределённый (::).
+ */
+void toMappedAddress(const QHostAddress& address, quint8* to);
+
+/**
+ * @brief  fromMappedAddress - возвращает адрес по его 16-байтовому виду.
+ * @param  from - 16 байт, записанные toMappedAddress.
+ * @return адрес (IPv4-mapped адрес - как IPv4).
+ */
+QHostAddress fromMappedAddress(const quint8* from);
+
 /**
  * @struct ClientInfo
  * @brief  Информация о подключённом к серверу клиенте.
+ *
+ * @note   Хранится в двоичном виде (32 байта, тривиально копируется): адрес - 16 байт IPv6
+ *         (IPv4 - в виде IPv4-mapped IPv6 ::ffff:a.b.c.d), время - миллисекунды UTC от начала эпохи.
+ *         Строки формируются только при выводе (XML, интерфейс клиента).
  */
 struct ClientInfo
 {
-    QString address;    //!< ip-адрес клиента.
-    quint16 port = 0;   //!< порт клиента.
-    QDateTime datetime; //!< время подключения.
+    static const qint64 invalidTime = std::numeric_limits<qint64>::min(); //!< значение времени подключения, если оно неизвестно.
+
+    qint64 connected = invalidTime; //!< время подключения, мс UTC от начала эпохи.
+    quint8 address[16] = {};        //!< ip-адрес клиента (network byte order).
+    quint16 port = 0;               //!< порт клиента.
 
     ClientInfo() = default;
+    ClientInfo(const QHostAddress& a, quint16 p, qint64 connectedMsecs);
+
+    /**
+     * @note Текстовый адрес, не являющийся ip-адресом, сохраняется как неопределённый (::).
+     */
     ClientInfo(const QString& a, quint16 p, const QDateTime& d);
 
+    /**
+     * @brief  hostAddress - возвращает адрес клиента (IPv4-mapped адрес - как IPv4).
+     */
+    QHostAddress hostAddress() const;
+
+    /**
+     * @brief setHostAddress - устанавливает адрес клиента.
+     */
+    void setHostAddress(const QHostAddress& a);
+
+    /**
+     * @brief  addressString - возвращает адрес клиента в текстовом виде.
+     */
+    QString addressString() const;
+
+    /**
+     * @brief  isIPv4 - проверяет, является ли адрес клиента адресом IPv4.
+     */
+    bool isIPv4() const;
+
+    /**
+     * @brief  datetime - возвращает время подключения в локальном времени.
+     * @return время подключения (недействительное - если неизвестно).
+     */
+    QDateTime datetime() const;
+
     bool operator== (const ClientInfo& rhs) const;
     bool operator!= (const ClientInfo& rhs) const;
 };
 
+uint qHash(const ClientInfo& key, uint seed = 0);
+
+/**
+ * @brief ClientInfoList - список информации о клиентах.
+ *
+ * @note  Элементы хранятся в одном непрерывном блоке памяти, а не отдельными узлами,
+ *        поэтому список из n клиентов после reserve() заполняется без дополнительных выделений памяти.
+ */
+typedef std::vector<ClientInfo> ClientInfoList;
+
+/**
+ * @struct RosterFilter
+ * @brief  Условия отбора клиентов в запросе InfoRequest.
+ *
+ * @note   Пустой фильтр означает полный список клиентов. Отобранные клиенты упорядочены по времени подключения,
+ *         offset и limit применяются к ним после отбора.
+ */
+struct RosterFilter
+{
+    /**
+     * @enum  Transport
+     * @brief Транспорт сервера, список клиентов которого запрашивается.
+     */
+    enum class Transport : quint8
+    {
+        Any = 0, //!< любой.
+        Tcp,     //!< только TCP-сервер.
+        Udp      //!< только UDP-сервер.
+    };
+
+    qint64 since = ClientInfo::invalidTime; //!< клиенты, подключившиеся не раньше, мс UTC от начала эпохи (invalidTime - любые).
+    quint8 network[16] = {};    //!< адрес подсети (в том же виде, что ClientInfo::address, биты узла - нулевые).
+    int prefixLength = -1;      //!< длина префикса подсети в битах 16-байтового адреса (-1 - любые адреса).
+    Transport transport = Transport::Any; //!< транспорт сервера.
+    quint32 offset = 0;         //!< количество пропускаемых отобранных клиентов.
+    quint32 limit = 0;          //!< наибольшее количество клиентов в ответе (0 - без ограничения).
+
+    /**
+     * @brief  isEmpty - проверяет, что фильтр не задаёт ни одного условия.
+     */
+    bool isEmpty() const;
+
+    /**
+     * @brief  setSubnet - устанавливает подсеть.
+     * @param  subnet - подсеть в виде "адрес/длина префикса" ("10.0.0.0/8", "fe80::/10") или отдельный адрес
+     *                  (пустая строка - любые адреса).
+     * @return false - если строка не является подсетью (фильтр не изменяется).
+     */
+    bool setSubnet(const QString& subnet);
+
+    /**
+     * @brief  subnet - возвращает подсеть в виде "адрес/длина префикса" (пустая строка - любые адреса).
+     */
+    QString subnet() const;
+
+    /**
+     * @brief setSubnetPrefix - устанавливает подсеть по адресу и длине префикса в битах 16-байтового адреса.
+     * @param address - адрес подсети (биты узла обнуляются).
+     * @param length - длина префикса (-1 - любые адреса).
+     */
+    void setSubnetPrefix(const quint8* address, int length);
+
+    /**
+     * @brief subnetRange - возвращает первый и последний адреса подсети (для поиска по упорядоченному индексу).
+     * @param first - первый адрес (16 байт).
+     * @param last - последний адрес (16 байт).
+     */
+    void subnetRange(quint8* first, quint8* last) const;
+
+    /**
+     * @brief  accepts - проверяет, удовлетворяет ли клиент условиям на время подключения и адрес.
+     */
+    bool accepts(const ClientInfo& client) const;
+
+    bool operator== (const RosterFilter& rhs) const;
+    bool operator!= (const RosterFilter& rhs) const;
+};
+
 /**
  * @class Message
  * @brief Сообщение инкапсулирующее протокол обмена информацией между сервером и клиентами.
@@ -44,10 +177,28 @@ public:
         Subscribe,   //!< запрос на регистрацию (клиент -> сервер).
         Unsubscribe, //!< запрос на отмену регистрации (клиент -> сервер).
         InfoRequest, //!< запрос списка всех клиентов (клиент -> сервер).
-        InfoResponse //!< ответ на запрос - список клиентов (сервер -> клиент).
+        InfoResponse,    //!< ответ на запрос - список клиентов (сервер -> клиент).
+        InfoNotModified, //!< ответ на запрос - список клиентов не изменился (сервер -> клиент).
+        InfoDelta,       //!< ответ на запрос - добавленные и удалённые клиенты (сервер -> клиент).
+        InfoBegin,       //!< начало списка клиентов, передаваемого частями (сервер -> клиент).
+        InfoChunk,       //!< очередная часть списка клиентов (сервер -> клиент).
+        InfoEnd          //!< конец списка клиентов, передаваемого частями (сервер -> клиент).
+    };
+
+    /**
+     * @enum  Codec
+     * @brief Формат кодирования тела сообщения.
+     */
+    enum class Codec
+    {
+        Xml = 0, //!< XML-документ (поддерживается всеми клиентами).
+        Binary   //!< компактный двоичный формат.
     };
 
 public:
+    static const quint32 maxFrameSize = 64 * 1024 * 1024; //!< наибольший допустимый размер тела кадра в байтах.
+    static const quint32 compressedFrameFlag = 0x80000000u; //!< старший бит длины кадра: тело сжато (см. compressFrame).
+
     Message() = default;
     explicit Message(Type type);
 
@@ -75,17 +226,140 @@ public:
      */
     void setBackwardPort(quint16 port);
 
+    /**
+     * @brief  codec - возвращает формат, в котором сообщение сериализуется (или из которого было разобрано).
+     * @return формат кодирования.
+     */
+    Codec codec() const;
+
+    /**
+     * @brief setCodec - устанавливает формат сериализации сообщения.
+     * @param codec - новый формат кодирования.
+     */
+    void setCodec(Codec codec);
+
+    /**
+     * @brief  preferredCodec - возвращает формат, в котором отправитель предпочитает получать ответы.
+     * @return формат кодирования.
+     */
+    Codec preferredCodec() const;
+
+    /**
+     * @brief setPreferredCodec - устанавливает формат, в котором отправитель предпочитает получать ответы.
+     * @param codec - предпочитаемый формат кодирования.
+     *
+     * @note  Передаётся в каждом запросе: клиенты, не знающие о двоичном формате, его не указывают
+     *        и продолжают получать ответы в XML.
+     */
+    void setPreferredCodec(Codec codec);
+
+    /**
+     * @brief  generation - возвращает номер поколения списка клиентов.
+     * @return номер поколения (0 - не известен).
+     *
+     * @note   В InfoRequest - последнее поколение, полученное клиентом;
+     *         в ответах сервера - текущее поколение списка клиентов.
+     */
+    quint64 generation() const;
+
+    /**
+     * @brief setGeneration - устанавливает номер поколения списка клиентов.
+     * @param generation - новый номер поколения.
+     */
+    void setGeneration(quint64 generation);
+
+    /**
+     * @brief  isPushed - возвращает признак того, что сообщение отправлено сервером без запроса клиента.
+     * @return true - если сообщение является уведомлением об изменении списка клиентов.
+     */
+    bool isPushed() const;
+
+    /**
+     * @brief setPushed - устанавливает признак отправки сообщения без запроса клиента.
+     * @param pushed - новое значение признака.
+     */
+    void setPushed(bool pushed);
+
+    /**
+     * @brief  acceptsChunks - возвращает признак того, что отправитель принимает список клиентов частями.
+     * @return true - если полный список клиентов может быть передан как InfoBegin, InfoChunk..., InfoEnd.
+     */
+    bool acceptsChunks() const;
+
+    /**
+     * @brief setAcceptsChunks - устанавливает признак приёма списка клиентов частями.
+     * @param accepts - новое значение признака.
+     *
+     * @note  Как и предпочитаемый формат, передаётся в каждом запросе: клиентам, которые его не указывают,
+     *        список клиентов по-прежнему отправляется одним сообщением InfoResponse.
+     */
+    void setAcceptsChunks(bool accepts);
+
+    /**
+     * @brief  acceptsCompression - возвращает признак того, что отправитель принимает сжатые кадры.
+     * @return true - если кадры для отправителя могут передаваться с флагом compressedFrameFlag.
+     */
+    bool acceptsCompression() const;
+
+    /**
+     * @brief setAcceptsCompression - устанавливает признак приёма сжатых кадров.
+     * @param accepts - новое значение признака.
+     *
+     * @note  Передаётся в каждом запросе, как и предпочитаемый формат: клиентам, которые его не указывают,
+     *        кадры отправляются несжатыми.
+     */
+    void setAcceptsCompression(bool accepts);
+
+    /**
+     * @brief  totalClients - возвращает количество клиентов в списке, передаваемом частями (для InfoBegin).
+     * @return количество клиентов во всех сообщениях InfoChunk до InfoEnd.
+     */
+    quint64 totalClients() const;
+
+    /**
+     * @brief setTotalClients - устанавливает количество клиентов в списке, передаваемом частями.
+     * @param total - новое количество клиентов.
+     */
+    void setTotalClients(quint64 total);
+
+    /**
+     * @brief  filter - возвращает условия отбора клиентов (для InfoRequest).
+     * @return фильтр (пустой - запрашивается полный список).
+     */
+    const RosterFilter& filter() const;
+
+    /**
+     * @brief setFilter - устанавливает условия отбора клиентов.
+     * @param filter - новый фильтр.
+     *
+     * @note  Ответ на запрос с непустым фильтром всегда содержит полный отобранный список (InfoResponse).
+     */
+    void setFilter(const RosterFilter& filter);
+
     /**
      * @brief  clientsInfo - возвращает список информации о клиентах.
      * @return список клиентов.
      */
-    const QList<ClientInfo>& clientsInfo() const;
+    const ClientInfoList& clientsInfo() const;
 
     /**
      * @brief setClientsInfo - заменяет список информации о клиентах.
      * @param info - новый список клиентов.
      */
-    void setClientsInfo(const QList<ClientInfo>& info);
+    void setClientsInfo(const ClientInfoList& info);
+    void setClientsInfo(ClientInfoList&& info);
+
+    /**
+     * @brief  takeClientsInfo - забирает список информации о клиентах без копирования.
+     * @return список клиентов (в сообщении остаётся пустой список).
+     */
+    ClientInfoList takeClientsInfo();
+
+    /**
+     * @brief reserveClientsInfo - резервирует память под count клиентов.
+     * @param count - ожидаемое количество клиентов.
+     */
+    void reserveClientsInfo(std::size_t count);
 
     /**
      * @brief resetClientsInfo - очищает список информации о клиентах.
@@ -97,21 +371,90 @@ public:
      * @param info - информация о клиенте.
      */
     void addClientInfo(const ClientInfo& info);
+    void addClientInfo(ClientInfo&& info);
+
+    /**
+     * @brief  emplaceClientInfo - создаёт информацию о клиенте непосредственно в списке.
+     * @param  args - аргументы конструктора ClientInfo.
+     * @return добавленный элемент.
+     */
+    template <typename... Args>
+    ClientInfo& emplaceClientInfo(Args&&... args)
+    {
+        m_info.emplace_back(std::forward<Args>(args)...);
+        return m_info.back();
+    }
+
+    /**
+     * @brief  removedClientsInfo - возвращает список отключившихся клиентов (для InfoDelta).
+     * @return список клиентов.
+     */
+    const ClientInfoList& removedClientsInfo() const;
+
+    /**
+     * @brief setRemovedClientsInfo - заменяет список отключившихся клиентов.
+     * @param info - новый список клиентов.
+     */
+    void setRemovedClientsInfo(const ClientInfoList& info);
+    void setRemovedClientsInfo(ClientInfoList&& info);
+
+    /**
+     * @brief  takeRemovedClientsInfo - забирает список отключившихся клиентов без копирования.
+     * @return список клиентов (в сообщении остаётся пустой список).
+     */
+    ClientInfoList takeRemovedClientsInfo();
+
+    /**
+     * @brief addRemovedClientInfo - добавляет информацию об отключившемся клиенте.
+     * @param info - информация о клиенте.
+     */
+    void addRemovedClientInfo(const ClientInfo& info);
+    void addRemovedClientInfo(ClientInfo&& info);
 
     /**
      * @brief  serialize - сериализует объект Message в массив байт для передачи.
-     * @return массив байт (UTF-8).
+     * @return массив байт (UTF-8 для Codec::Xml).
      */
     QByteArray serialize() const;
 
+    /**
+     * @brief  serializeInto - дописывает в конец буфера кадр для передачи: длину (quint32, big-endian) и тело.
+     * @param  to - буфер отправки.
+     * @return размер дописанного кадра в байтах.
+     *
+     * @note   Место под длину резервируется перед кодированием тела и заполняется после него,
+     *         поэтому тело не копируется повторно. Буфер можно использовать многократно:
+     *         после reserve() вызов resize(0) очищает его без освобождения памяти.
+     */
+    int serializeInto(QByteArray& to) const;
+
     /**
      * @brief  parse - заполняет объект Message из массива байт.
-     * @param  raw - массив байт (UTF-8).
+     * @param  raw - массив байт (UTF-8 или двоичный формат - определяется автоматически).
      * @param  ok - флаг успешности выполнения десериализации.
      * @return объект Message.
      */
     static Message parse(const QByteArray& raw, bool* ok = nullptr);
 
+    /**
+     * @brief  compressFrame - сжимает тело готового кадра (zlib, qCompress) и устанавливает в его длине compressedFrameFlag.
+     * @param  frame - кадр (размер + несжатое тело).
+     * @param  threshold - наименьший размер тела в байтах, начиная с которого оно сжимается.
+     * @return сжатый кадр или исходный кадр без копирования, если тело меньше threshold или не уменьшается при сжатии.
+     *
+     * @note   Длина сжатого кадра - размер сжатого тела; сжатое тело начинается с размера исходного (quint32, big-endian).
+     */
+    static QByteArray compressFrame(const QByteArray& frame, int threshold);
+
+    /**
+     * @brief  uncompressPayload - восстанавливает тело кадра, переданного с флагом compressedFrameFlag.
+     * @param  data - сжатое тело.
+     * @param  size - размер сжатого тела в байтах.
+     * @param  payload - восстановленное тело.
+     * @return false - если данные повреждены или исходное тело больше maxFrameSize.
+     */
+    static bool uncompressPayload(const char* data, int size, QByteArray* payload);
+
     /**
      * @brief  typeToString - преобразует значение Type в его строковое представление.
      * @param  type - значение для преобразования.
@@ -126,11 +469,25 @@ public:
      */
     static Type typeFromString(const QString& type);
 
+private:
+    QByteArray serializeXml() const;
+    static Message parseXml(const QByteArray& raw);
+
 private:
     Type m_type = Type::Unknown; //!< тип сообщения.
     quint16 m_backwardPort = 0;  //!< порт приёма ответа.
+    quint64 m_generation = 0;    //!< номер поколения списка клиентов.
+    bool m_pushed = false;       //!< сообщение отправлено без запроса.
+    bool m_acceptsChunks = false; //!< отправитель принимает список клиентов частями.
+    bool m_acceptsCompression = false; //!< отправитель принимает сжатые кадры.
+    quint64 m_totalClients = 0;  //!< количество клиентов в списке, передаваемом частями.
+    Codec m_codec = Codec::Xml;           //!< формат сериализации сообщения.
+    Codec m_preferredCodec = Codec::Xml;  //!< формат, в котором отправитель ожидает ответы.
+
+    RosterFilter m_filter;    //!< условия отбора клиентов.
 
-    QList<ClientInfo> m_info;    //!< список клиентов.
+    ClientInfoList m_info;    //!< список клиентов.
+    ClientInfoList m_removed; //!< список отключившихся клиентов.
 
 };
 
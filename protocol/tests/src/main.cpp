@@ -3,8 +3,14 @@
 #include <QByteArray>
 #include <QDataStream>
 #include <QDateTime>
+#include <QHostAddress>
 #include <QString>
+#include <QtEndian>
 
+#include <cstring>
+#include <type_traits>
+
+#include "framedecoder.h"
 #include "protocol.h"
 
 class SerializeTest : public QObject
@@ -20,8 +26,8 @@ private slots:
         original.setBackwardPort(54321);
 
         original.addClientInfo(ClientInfo("127.0.0.1",   12345, QDateTime::fromString("10:00:00 28-06-2017", "hh:mm:ss dd-MM-yyyy")));
-        original.addClientInfo(ClientInfo("localhost",   23456, QDateTime::fromString("11:11:11 29-07-2017", "hh:mm:ss dd-MM-yyyy")));
-        original.addClientInfo(ClientInfo("lorem_ipsum", 34567, QDateTime::fromString("12:12:12 30-08-2017", "hh:mm:ss dd-MM-yyyy")));
+        original.addClientInfo(ClientInfo("192.168.0.1", 23456, QDateTime::fromString("11:11:11 29-07-2017", "hh:mm:ss dd-MM-yyyy")));
+        original.addClientInfo(ClientInfo("2001:db8::1", 34567, QDateTime::fromString("12:12:12 30-08-2017", "hh:mm:ss dd-MM-yyyy")));
 
         QByteArray serialized;
         {
@@ -39,6 +45,448 @@ private slots:
         QCOMPARE(original.clientsInfo(), parsed.clientsInfo());
     }
 
+    void slotXmlParseTest()
+    {
+        using namespace Netcom;
+
+        bool ok = false;
+        Message parsed = Message::parse("<!DOCTYPE netcom>\n"
+                                        "<netcom>"
+                                        "<message type=\"info_response\">"
+                                        "<client address=\"10.0.0.1\" port=\"1\" datetime=\"10:00:00 28-06-2017\"/>"
+                                        "<clients>"
+                                        "<client address=\"10.0.0.2\" port=\"2\" datetime=\"10:00:00 28-06-2017\"/>"
+                                        "<client address=\"10.0.0.3\" port=\"3\"/>"
+                                        "</clients>"
+                                        "</message>"
+                                        "<options backward_port=\"4\"/>"
+                                        "</netcom>",
+                                        &ok);
+        QVERIFY(ok);
+        QCOMPARE(parsed.type(), Message::Type::InfoResponse);
+        QCOMPARE(parsed.backwardPort(), static_cast<quint16>(4));
+        QCOMPARE(parsed.clientsInfo().size(), static_cast<std::size_t>(1));
+        QCOMPARE(parsed.clientsInfo().front().addressString(), QString("10.0.0.2"));
+
+        parsed = Message::parse("<netcom><message type=\"info_request\"></netcom>", &ok);
+        QVERIFY(!ok);
+        QCOMPARE(parsed.type(), Message::Type::Unknown);
+    }
+
+    void slotTypeNamesTest()
+    {
+        using namespace Netcom;
+
+        for (int each = static_cast<int>(Message::Type::Unknown); each <= static_cast<int>(Message::Type::InfoEnd); ++each)
+        {
+            const Message::Type type = static_cast<Message::Type>(each);
+            QCOMPARE(Message::typeFromString(Message::typeToString(type)), type);
+        }
+        QCOMPARE(Message::typeToString(Message::Type::InfoNotModified), QString("info_not_modified"));
+        QCOMPARE(Message::typeToString(static_cast<Message::Type>(100)), QString("unknown"));
+        QCOMPARE(Message::typeFromString("info_respons"), Message::Type::Unknown);
+        QCOMPARE(Message::typeFromString("info_reqvest"), Message::Type::Unknown);
+        QCOMPARE(Message::typeFromString(QString::null), Message::Type::Unknown);
+    }
+
+    void slotXmlTimestampTest()
+    {
+        using namespace Netcom;
+
+        // миллисекунды теряются в строке datetime, но сохраняются в атрибуте msecs.
+        Message original(Message::Type::InfoResponse);
+        original.emplaceClientInfo(QHostAddress("10.0.0.1"), 1, Q_INT64_C(1498644000123));
+
+        bool ok = false;
+        Message parsed = Message::parse(original.serialize(), &ok);
+        QVERIFY(ok);
+        QCOMPARE(parsed.clientsInfo(), original.clientsInfo());
+
+        // msecs предпочитается строке, прежние версии передают только строку.
+        parsed = Message::parse("<netcom><message type=\"info_response\"><clients>"
+                                "<client address=\"10.0.0.1\" port=\"1\" datetime=\"10:00:00 28-06-2017\" msecs=\"1000\"/>"
+                                "<client address=\"10.0.0.2\" port=\"2\" datetime=\"10:00:00 28-06-2017\"/>"
+                                "</clients></message></netcom>",
+                                &ok);
+        QVERIFY(ok);
+        QCOMPARE(parsed.clientsInfo().size(), static_cast<std::size_t>(2));
+        QCOMPARE(parsed.clientsInfo().front().connected, Q_INT64_C(1000));
+        QCOMPARE(parsed.clientsInfo().back().datetime(), QDateTime::fromString("10:00:00 28-06-2017", "hh:mm:ss dd-MM-yyyy"));
+    }
+
+    void slotBinarySerializeTest()
+    {
+        using namespace Netcom;
+
+        Message original(Message::Type::InfoResponse);
+        original.setCodec(Message::Codec::Binary);
+        original.setPreferredCodec(Message::Codec::Binary);
+        original.setBackwardPort(54321);
+
+        original.addClientInfo(ClientInfo("127.0.0.1",        12345, QDateTime::fromString("10:00:00 28-06-2017", "hh:mm:ss dd-MM-yyyy")));
+        original.addClientInfo(ClientInfo("::ffff:10.0.0.1",  23456, QDateTime::fromString("11:11:11 29-07-2017", "hh:mm:ss dd-MM-yyyy")));
+        original.addClientInfo(ClientInfo("2001:db8::2",      34567, QDateTime()));
+
+        QByteArray serialized;
+        {
+            QDataStream output(&serialized, QIODevice::WriteOnly);
+            output << original;
+        }
+
+        Message parsed;
+        {
+            QDataStream input(serialized);
+            input >> parsed;
+        }
+
+        QCOMPARE(parsed.codec(), Message::Codec::Binary);
+        QCOMPARE(original.type(), parsed.type());
+        QCOMPARE(original.backwardPort(), parsed.backwardPort());
+        QCOMPARE(original.preferredCodec(), parsed.preferredCodec());
+        QCOMPARE(original.clientsInfo(), parsed.clientsInfo());
+
+        bool ok = true;
+        Message::parse(original.serialize().left(10), &ok);
+        QVERIFY(!ok);
+    }
+
+    void slotDeltaSerializeTest()
+    {
+        using namespace Netcom;
+
+        Message original(Message::Type::InfoDelta);
+        original.setGeneration(Q_UINT64_C(1498644000123));
+        original.setPushed(true);
+        original.addClientInfo(ClientInfo("127.0.0.1", 12345, QDateTime::fromString("10:00:00 28-06-2017", "hh:mm:ss dd-MM-yyyy")));
+        original.addRemovedClientInfo(ClientInfo("10.0.0.1", 23456, QDateTime::fromString("11:11:11 29-07-2017", "hh:mm:ss dd-MM-yyyy")));
+
+        for (Message::Codec codec : { Message::Codec::Xml, Message::Codec::Binary })
+        {
+            original.setCodec(codec);
+
+            bool ok = false;
+            Message parsed = Message::parse(original.serialize(), &ok);
+            QVERIFY(ok);
+            QCOMPARE(parsed.type(), Message::Type::InfoDelta);
+            QCOMPARE(parsed.generation(), original.generation());
+            QVERIFY(parsed.isPushed());
+            QCOMPARE(parsed.clientsInfo(), original.clientsInfo());
+            QCOMPARE(parsed.removedClientsInfo(), original.removedClientsInfo());
+        }
+    }
+
+    void slotClientsStorageTest()
+    {
+        using namespace Netcom;
+
+        QDateTime connected = QDateTime::fromString("10:00:00 28-06-2017", "hh:mm:ss dd-MM-yyyy");
+
+        Message message(Message::Type::InfoResponse);
+        message.reserveClientsInfo(3);
+        message.emplaceClientInfo("10.0.0.1", 1, connected);
+        message.addClientInfo(ClientInfo("10.0.0.2", 2, connected));
+        ClientInfo third("10.0.0.3", 3, connected);
+        message.addClientInfo(third);
+        QCOMPARE(message.clientsInfo().size(), static_cast<std::size_t>(3));
+        QCOMPARE(message.clientsInfo().back(), third);
+
+        const ClientInfo* storage = message.clientsInfo().data();
+        ClientInfoList taken = message.takeClientsInfo();
+        QVERIFY(message.clientsInfo().empty());
+        QCOMPARE(taken.size(), static_cast<std::size_t>(3));
+        // список передаётся без копирования элементов.
+        QVERIFY(taken.data() == storage);
+
+        message.setRemovedClientsInfo(std::move(taken));
+        QCOMPARE(message.removedClientsInfo().data(), storage);
+        QCOMPARE(message.takeRemovedClientsInfo().front().addressString(), QString("10.0.0.1"));
+        QVERIFY(message.removedClientsInfo().empty());
+    }
+
+    void slotClientInfoTest()
+    {
+        using namespace Netcom;
+
+        QVERIFY(std::is_trivially_copyable<ClientInfo>::value);
+        QCOMPARE(sizeof(ClientInfo), static_cast<std::size_t>(32));
+
+        QDateTime connected = QDateTime::fromString("10:00:00 28-06-2017", "hh:mm:ss dd-MM-yyyy");
+        ClientInfo ipv4("10.0.0.1", 1, connected);
+        QVERIFY(ipv4.isIPv4());
+        QCOMPARE(ipv4.addressString(), QString("10.0.0.1"));
+        QCOMPARE(ipv4.hostAddress(), QHostAddress("10.0.0.1"));
+        QCOMPARE(ipv4.datetime(), connected);
+        // IPv4-mapped адрес хранится так же, как IPv4.
+        QCOMPARE(ClientInfo("::ffff:10.0.0.1", 1, connected), ipv4);
+
+        ClientInfo ipv6(QHostAddress("2001:db8::1"), 2, ClientInfo::invalidTime);
+        QVERIFY(!ipv6.isIPv4());
+        QCOMPARE(ipv6.addressString(), QString("2001:db8::1"));
+        QVERIFY(!ipv6.datetime().isValid());
+        QVERIFY(ipv6 != ipv4);
+    }
+
+    void slotFrameDecoderTest()
+    {
+        using namespace Netcom;
+
+        Message first(Message::Type::Subscribe);
+        first.setBackwardPort(1000);
+        Message second(Message::Type::InfoRequest);
+        second.setCodec(Message::Codec::Binary);
+        Message third(Message::Type::Unsubscribe);
+
+        QByteArray stream;
+        int split = 0;
+        {
+            QDataStream output(&stream, QIODevice::WriteOnly);
+            output << first;
+            split = stream.size() + 2;
+            output << second << third;
+        }
+
+        FrameDecoder decoder;
+        Message parsed;
+
+        // первый кадр и часть второго.
+        decoder.append(stream.left(split));
+        QVERIFY(decoder.next(&parsed));
+        QCOMPARE(parsed.type(), Message::Type::Subscribe);
+        QCOMPARE(parsed.backwardPort(), static_cast<quint16>(1000));
+        QVERIFY(!decoder.next(&parsed));
+
+        decoder.append(stream.mid(split));
+        QVERIFY(decoder.next(&parsed));
+        QCOMPARE(parsed.type(), Message::Type::InfoRequest);
+        QCOMPARE(parsed.codec(), Message::Codec::Binary);
+        QVERIFY(decoder.next(&parsed));
+        QCOMPARE(parsed.type(), Message::Type::Unsubscribe);
+        QVERIFY(!decoder.next(&parsed));
+        QCOMPARE(decoder.pendingSize(), 0);
+
+        // кадр с длиной больше допустимой не накапливается.
+        QByteArray oversized(4, '\0');
+        qToBigEndian<quint32>(Message::maxFrameSize + 1, reinterpret_cast<uchar*>(oversized.data()));
+        decoder.append(oversized);
+        decoder.append(QByteArray(1024, 'x'));
+        QVERIFY(!decoder.next(&parsed));
+        QVERIFY(decoder.isCorrupted());
+        QCOMPARE(decoder.pendingSize(), 0);
+
+        QDataStream input(oversized);
+        input >> parsed;
+        QCOMPARE(input.status(), QDataStream::ReadCorruptData);
+        QCOMPARE(parsed.type(), Message::Type::Unknown);
+
+        decoder.clear();
+        QVERIFY(!decoder.isCorrupted());
+        decoder.append(stream);
+        QVERIFY(decoder.next(&parsed));
+        QCOMPARE(parsed.type(), Message::Type::Subscribe);
+    }
+
+    void slotChunkedRosterTest()
+    {
+        using namespace Netcom;
+
+        for (Message::Codec codec : { Message::Codec::Xml, Message::Codec::Binary })
+        {
+            Message request(Message::Type::InfoRequest);
+            request.setCodec(codec);
+            request.setAcceptsChunks(true);
+
+            bool ok = false;
+            Message parsed = Message::parse(request.serialize(), &ok);
+            QVERIFY(ok);
+            QVERIFY(parsed.acceptsChunks());
+            QVERIFY(!Message::parse(Message(Message::Type::InfoRequest).serialize()).acceptsChunks());
+
+            Message begin(Message::Type::InfoBegin);
+            begin.setCodec(codec);
+            begin.setGeneration(7);
+            begin.setTotalClients(100000);
+            parsed = Message::parse(begin.serialize(), &ok);
+            QVERIFY(ok);
+            QCOMPARE(parsed.type(), Message::Type::InfoBegin);
+            QCOMPARE(parsed.generation(), static_cast<quint64>(7));
+            QCOMPARE(parsed.totalClients(), static_cast<quint64>(100000));
+
+            Message chunk(Message::Type::InfoChunk);
+            chunk.setCodec(codec);
+            chunk.setPushed(true);
+            chunk.emplaceClientInfo(QHostAddress("10.0.0.1"), 1000, Q_INT64_C(1500000000000));
+            chunk.emplaceClientInfo(QHostAddress("fe80::1"), 2000, Q_INT64_C(1500000000001));
+            parsed = Message::parse(chunk.serialize(), &ok);
+            QVERIFY(ok);
+            QCOMPARE(parsed.type(), Message::Type::InfoChunk);
+            QVERIFY(parsed.isPushed());
+            QVERIFY(parsed.clientsInfo() == chunk.clientsInfo());
+            QCOMPARE(parsed.totalClients(), static_cast<quint64>(0));
+
+            parsed = Message::parse(Message(Message::Type::InfoEnd).serialize(), &ok);
+            QVERIFY(ok);
+            QCOMPARE(parsed.type(), Message::Type::InfoEnd);
+        }
+    }
+
+    void slotCompressionTest()
+    {
+        using namespace Netcom;
+
+        Message request(Message::Type::InfoRequest);
+        request.setAcceptsCompression(true);
+        QVERIFY(Message::parse(request.serialize()).acceptsCompression());
+        request.setCodec(Message::Codec::Binary);
+        QVERIFY(Message::parse(request.serialize()).acceptsCompression());
+        QVERIFY(!Message::parse(Message(Message::Type::InfoRequest).serialize()).acceptsCompression());
+
+        Message roster(Message::Type::InfoResponse);
+        for (int i = 0; i < 100; ++i)
+        {
+            roster.emplaceClientInfo(QHostAddress(0x0A000000u + i), static_cast<quint16>(1024 + i), Q_INT64_C(1500000000000) + i);
+        }
+        QByteArray plain;
+        roster.serializeInto(plain);
+
+        // тело меньше порога не сжимается.
+        QByteArray small;
+        Message(Message::Type::InfoRequest).serializeInto(small);
+        QCOMPARE(Message::compressFrame(small, 1024), small);
+        QCOMPARE(Message::compressFrame(plain, plain.size()), plain);
+
+        QByteArray compressed = Message::compressFrame(plain, 1024);
+        QVERIFY(compressed.size() < plain.size());
+        QVERIFY((qFromBigEndian<quint32>(reinterpret_cast<const uchar*>(compressed.constData())) & Message::compressedFrameFlag) != 0);
+        QCOMPARE(Message::compressFrame(compressed, 0), compressed);
+
+        FrameDecoder decoder;
+        decoder.append(compressed);
+        decoder.append(plain);
+        Message parsed;
+        QVERIFY(decoder.next(&parsed));
+        QVERIFY(parsed.clientsInfo() == roster.clientsInfo());
+        QVERIFY(decoder.next(&parsed));
+        QVERIFY(parsed.clientsInfo() == roster.clientsInfo());
+        QVERIFY(!decoder.next(&parsed));
+
+        QDataStream input(compressed);
+        input >> parsed;
+        QCOMPARE(input.status(), QDataStream::Ok);
+        QVERIFY(parsed.clientsInfo() == roster.clientsInfo());
+
+        // сжатое тело с заявленным размером больше допустимого не восстанавливается.
+        QByteArray bomb(compressed.mid(4));
+        qToBigEndian<quint32>(Message::maxFrameSize + 1, reinterpret_cast<uchar*>(bomb.data()));
+        QByteArray restored;
+        QVERIFY(!Message::uncompressPayload(bomb.constData(), bomb.size(), &restored));
+        QVERIFY(Message::uncompressPayload(compressed.constData() + 4, compressed.size() - 4, &restored));
+        QCOMPARE(restored, plain.mid(4));
+    }
+
+    void slotRosterFilterTest()
+    {
+        using namespace Netcom;
+
+        RosterFilter filter;
+        QVERIFY(filter.isEmpty());
+        QVERIFY(filter.accepts(ClientInfo(QHostAddress("10.1.2.3"), 1, 0)));
+
+        QVERIFY(!filter.setSubnet("10.0.0.0/33"));
+        QVERIFY(!filter.setSubnet("not an address"));
+        QVERIFY(filter.setSubnet("10.1.255.255/16"));
+        QCOMPARE(filter.subnet(), QString("10.1.0.0/16"));
+        QVERIFY(filter.accepts(ClientInfo(QHostAddress("10.1.2.3"), 1, 0)));
+        QVERIFY(!filter.accepts(ClientInfo(QHostAddress("10.2.2.3"), 1, 0)));
+        QVERIFY(!filter.accepts(ClientInfo(QHostAddress("::1"), 1, 0)));
+
+        quint8 first[16];
+        quint8 last[16];
+        filter.subnetRange(first, last);
+        ClientInfo edge;
+        std::memcpy(edge.address, first, sizeof(edge.address));
+        QCOMPARE(edge.hostAddress(), QHostAddress("10.1.0.0"));
+        std::memcpy(edge.address, last, sizeof(edge.address));
+        QCOMPARE(edge.hostAddress(), QHostAddress("10.1.255.255"));
+
+        QVERIFY(filter.setSubnet("fe80::/10"));
+        QVERIFY(filter.accepts(ClientInfo(QHostAddress("fe80::1"), 1, 0)));
+        QVERIFY(!filter.accepts(ClientInfo(QHostAddress("10.1.2.3"), 1, 0)));
+
+        filter.since = 1000;
+        QVERIFY(!filter.accepts(ClientInfo(QHostAddress("fe80::1"), 1, 999)));
+        QVERIFY(filter.accepts(ClientInfo(QHostAddress("fe80::1"), 1, 1000)));
+        filter.transport = RosterFilter::Transport::Udp;
+        filter.offset = 5;
+        filter.limit = 10;
+
+        // фильтр передаётся в обоих форматах.
+        for (Message::Codec codec : { Message::Codec::Xml, Message::Codec::Binary })
+        {
+            Message request(Message::Type::InfoRequest);
+            request.setCodec(codec);
+            request.setFilter(filter);
+
+            bool ok = false;
+            Message parsed = Message::parse(request.serialize(), &ok);
+            QVERIFY(ok);
+            QVERIFY(parsed.filter() == filter);
+        }
+
+        bool ok = false;
+        QVERIFY(Message::parse(Message(Message::Type::InfoRequest).serialize(), &ok).filter().isEmpty());
+        QVERIFY(ok);
+    }
+
+    void slotSerializeIntoTest()
+    {
+        using namespace Netcom;
+
+        Message xml(Message::Type::InfoRequest);
+        xml.setBackwardPort(1000);
+        Message binary(Message::Type::InfoResponse);
+        binary.setCodec(Message::Codec::Binary);
+        binary.emplaceClientInfo(QHostAddress("10.0.0.1"), 1, Q_INT64_C(1498644000000));
+
+        QByteArray expected;
+        {
+            QDataStream output(&expected, QIODevice::WriteOnly);
+            output << xml << binary;
+        }
+
+        // кадры дописываются в конец буфера в том же виде, что и через QDataStream.
+        QByteArray buffer;
+        buffer.reserve(4096);
+        const int first = xml.serializeInto(buffer);
+        const int second = binary.serializeInto(buffer);
+        QCOMPARE(first + second, buffer.size());
+        QCOMPARE(buffer, expected);
+
+        // повторное использование буфера не освобождает память.
+        const char* data = buffer.constData();
+        buffer.resize(0);
+        xml.serializeInto(buffer);
+        QCOMPARE(buffer, expected.left(first));
+        QVERIFY(buffer.constData() == data);
+    }
+
+    void slotCodecNegotiationTest()
+    {
+        using namespace Netcom;
+
+        Message request(Message::Type::InfoRequest);
+        request.setPreferredCodec(Message::Codec::Binary);
+
+        bool ok = false;
+        Message parsed = Message::parse(request.serialize(), &ok);
+        QVERIFY(ok);
+        QCOMPARE(parsed.codec(), Message::Codec::Xml);
+        QCOMPARE(parsed.preferredCodec(), Message::Codec::Binary);
+
+        parsed = Message::parse(Message(Message::Type::InfoRequest).serialize(), &ok);
+        QVERIFY(ok);
+        QCOMPARE(parsed.preferredCodec(), Message::Codec::Xml);
+    }
+
 };
 
 QTEST_MAIN(SerializeTest)
@@ -3,6 +3,7 @@ PROJECT = serialize-test
 TARGET = $$PROJECT
 
 QT += core \
+      network \
       xml \
       testlib
 QT -= gui
@@ -16,10 +17,14 @@ OBJECTS_DIR = $$PWD/build/obj
 MOC_DIR = $$PWD/build/moc
 
 SOURCES = \
+    ../src/binarycodec.cpp \
+    ../src/framedecoder.cpp \
     ../src/protocol.cpp \
     src/main.cpp
 
 HEADERS = \
+    ../src/binarycodec.h \
+    ../src/framedecoder.h \
     ../src/protocol.h
 
 #installs
@@ -0,0 +1,31 @@
+TEMPLATE = app
+PROJECT = server-benchmark
+TARGET = $$PROJECT
+
+QT += core \
+      network \
+      testlib
+QT -= gui
+
+CONFIG += warn_on
+QMAKE_CXXFLAGS += -Wall -Werror -Wextra -pedantic-errors
+QMAKE_CXXFLAGS += -std=c++14
+
+DESTDIR = $$PWD/build/sbin
+OBJECTS_DIR = $$PWD/build/obj
+MOC_DIR = $$PWD/build/moc
+
+SOURCES = \
+    ../src/nativesocket.cpp \
+    src/main.cpp
+
+HEADERS = \
+    ../src/nativesocket.h
+
+#installs
+target.path = $$PREFIX/sbin
+
+INSTALLS += \
+    target
+
+INCLUDEPATH += ../src
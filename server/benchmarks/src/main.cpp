@@ -0,0 +1,122 @@
+#include <QtTest>
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QHostAddress>
+#include <QUdpSocket>
+
+#include "nativesocket.h"
+
+namespace
+{
+
+const int datagramsCount = 128; //!< датаграмм за итерацию (помещаются в буфер приёма сокета без потерь).
+const int datagramSize = 64;    //!< размер датаграммы, сопоставимый с запросом InfoRequest.
+const int timeoutMsec = 1000;   //!< предельное время ожидания датаграмм одной итерации.
+
+}
+
+/**
+ * @class UdpBenchmark
+ * @brief Сравнение пропускной способности (датаграмм в секунду) обмена через QUdpSocket
+ *        и пакетного обмена recvmmsg/sendmmsg.
+ *
+ * @note  Итерация - отправка и приём datagramsCount датаграмм через петлевой интерфейс,
+ *        пропускная способность = datagramsCount / время итерации.
+ */
+class UdpBenchmark : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase()
+    {
+        m_datagram.fill('x', ::datagramSize);
+    }
+
+    void slotQtSocketBenchmark()
+    {
+        QUdpSocket receiver;
+        QUdpSocket sender;
+        QVERIFY(receiver.bind(QHostAddress::LocalHost, 0));
+
+        QByteArray buffer(65536, Qt::Uninitialized);
+        QBENCHMARK
+        {
+            for (int i = 0; i < ::datagramsCount; ++i)
+            {
+                sender.writeDatagram(m_datagram, QHostAddress::LocalHost, receiver.localPort());
+            }
+
+            int received = 0;
+            QElapsedTimer timer;
+            timer.start();
+            while (   received < ::datagramsCount
+                   && timer.elapsed() < ::timeoutMsec)
+            {
+                if (   !receiver.hasPendingDatagrams()
+                    && !receiver.waitForReadyRead(::timeoutMsec))
+                {
+                    break;
+                }
+                while (receiver.hasPendingDatagrams())
+                {
+                    receiver.readDatagram(buffer.data(), buffer.size());
+                    ++received;
+                }
+            }
+            QCOMPARE(received, ::datagramsCount);
+        }
+    }
+
+    void slotBatchBenchmark()
+    {
+        if (!Netcom::NativeSocket::DatagramBatch::isSupported())
+        {
+            QSKIP("recvmmsg/sendmmsg are not supported on this platform");
+        }
+
+        QString error;
+        qintptr receiver = Netcom::NativeSocket::openBound(QAbstractSocket::UdpSocket, QHostAddress::LocalHost, 0, false, &error);
+        qintptr sender = Netcom::NativeSocket::openBound(QAbstractSocket::UdpSocket, QHostAddress::LocalHost, 0, false, &error);
+        QVERIFY2(receiver >= 0 && sender >= 0, qPrintable(error));
+
+        // порт приёмника, выбранный системой, узнаётся через QUdpSocket, не забирающий дескриптор.
+        QUdpSocket probe;
+        QVERIFY(probe.setSocketDescriptor(receiver, QAbstractSocket::BoundState));
+        quint16 port = probe.localPort();
+
+        Netcom::NativeSocket::DatagramBatch batch(::datagramsCount);
+        QBENCHMARK
+        {
+            for (int i = 0; i < ::datagramsCount; ++i)
+            {
+                batch.append(QHostAddress::LocalHost, port, m_datagram);
+            }
+            QCOMPARE(batch.flush(sender), ::datagramsCount);
+
+            int received = 0;
+            QElapsedTimer timer;
+            timer.start();
+            while (   received < ::datagramsCount
+                   && timer.elapsed() < ::timeoutMsec)
+            {
+                int count = batch.receive(receiver);
+                QVERIFY(count >= 0);
+                received += count;
+            }
+            QCOMPARE(received, ::datagramsCount);
+        }
+
+        probe.close();
+        Netcom::NativeSocket::close(sender);
+    }
+
+private:
+    QByteArray m_datagram; //!< отправляемая датаграмма.
+
+};
+
+QTEST_MAIN(UdpBenchmark)
+
+#include "main.moc"
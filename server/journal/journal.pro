@@ -0,0 +1,37 @@
+TEMPLATE = app
+PROJECT = netcom-journal
+TARGET = $$PROJECT
+
+CONFIG += console
+CONFIG -= app_bundle
+
+QT += core \
+      network
+QT -= gui
+
+CONFIG += warn_on
+
+QMAKE_CXXFLAGS += -Wall -Werror -Wextra -pedantic-errors
+QMAKE_CXXFLAGS += -std=c++14
+
+DESTDIR = $$PWD/build/bin
+OBJECTS_DIR = $$PWD/build/obj
+MOC_DIR = $$PWD/build/moc
+
+SOURCES += \
+    ../src/journal.cpp \
+    src/main.cpp
+
+HEADERS += \
+    ../src/journal.h
+
+# installs
+target.path = $$PREFIX/bin
+
+INSTALLS += \
+    target
+
+INCLUDEPATH += ../src
+INCLUDEPATH += $$PREFIX/include
+
+LIBS += -L$$PREFIX/lib -lprotocol
@@ -0,0 +1,528 @@
+#include <cstring>
+
+#include <QByteArray>
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QHash>
+#include <QHostAddress>
+#include <QPair>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include <QTcpSocket>
+#include <QTextStream>
+#include <QTimer>
+#include <QUdpSocket>
+#include <QUrl>
+
+#include <protocol.h>
+
+#include "journal.h"
+
+namespace
+{
+
+int connectTimeoutMsec() { return 3000; }
+
+int drainTimeoutMsec() { return 200; }
+
+/**
+ * @struct Filter
+ * @brief  Условия отбора записей журнала (пустое условие пропускает все записи).
+ */
+struct Filter
+{
+    QSet<Netcom::JournalRecord::Event> events; //!< отбираемые события.
+    bool hasAddress = false;                   //!< отбор по адресу клиента.
+    quint8 address[16] = {};                   //!< адрес клиента (в том же виде, что JournalRecord::address).
+    QAbstractSocket::SocketType transport = QAbstractSocket::UnknownSocketType; //!< транспорт сервера.
+    bool hasConnection = false;                //!< отбор по идентификатору подключения.
+    quint64 connection = 0;                    //!< идентификатор подключения.
+
+    bool accepts(const Netcom::JournalRecord& record) const
+    {
+        // записи начала сеанса нужны для восстановления времени и не отбрасываются.
+        if (record.event == Netcom::JournalRecord::Event::Start)
+        {
+            return true;
+        }
+        return (   (events.isEmpty() || events.contains(record.event))
+                && (!hasAddress || std::memcmp(address, record.address, sizeof(address)) == 0)
+                && (transport == QAbstractSocket::UnknownSocketType || transport == record.transport)
+                && (!hasConnection || connection == record.connection));
+    }
+};
+
+QString transportName(QAbstractSocket::SocketType transport)
+{
+    switch (transport)
+    {
+    case QAbstractSocket::TcpSocket:
+        return "tcp";
+    case QAbstractSocket::UdpSocket:
+        return "udp";
+    default:
+        break;
+    }
+    return "-";
+}
+
+/**
+ * @class JournalReader
+ * @brief Последовательное чтение записей файла журнала.
+ */
+class JournalReader
+{
+public:
+    bool open(const QString& fileName, QString* error)
+    {
+        m_file.setFileName(fileName);
+        if (!m_file.open(QFile::ReadOnly))
+        {
+            *error = m_file.errorString();
+            return false;
+        }
+        if (m_file.read(Netcom::journalSignature().size()) != Netcom::journalSignature())
+        {
+            *error = QCoreApplication::translate("main", "%1 is not a journal file").arg(fileName);
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief  next - читает следующую запись.
+     * @return false - если записи закончились или запись повреждена.
+     */
+    bool next(Netcom::JournalRecord* record)
+    {
+        char raw[Netcom::JournalRecord::Size];
+        qint64 size = m_file.read(raw, sizeof(raw));
+        if (size != static_cast<qint64>(sizeof(raw)))
+        {
+            if (size > 0)
+            {
+                qWarning().noquote() << QCoreApplication::translate("main", "Truncated record at the end of the journal");
+            }
+            return false;
+        }
+        if (!record->decode(raw))
+        {
+            qWarning().noquote() << QCoreApplication::translate("main", "Corrupted record at offset %1")
+                                    .arg(m_file.pos() - Netcom::JournalRecord::Size);
+            return false;
+        }
+        if (record->event == Netcom::JournalRecord::Event::Start)
+        {
+            ++m_session;
+            m_sessionStart = static_cast<qint64>(record->generation);
+        }
+        return true;
+    }
+
+    int session() const { return m_session; }
+
+    /**
+     * @brief  wallClock - переводит время записи текущего сеанса в календарное время.
+     */
+    QDateTime wallClock(const Netcom::JournalRecord& record) const
+    {
+        return QDateTime::fromMSecsSinceEpoch(m_sessionStart + static_cast<qint64>(record.timestamp / 1000000));
+    }
+
+private:
+    QFile m_file;              //!< файл журнала.
+    int m_session = 0;         //!< номер текущего сеанса записи.
+    qint64 m_sessionStart = 0; //!< время начала текущего сеанса, мс от начала эпохи.
+
+};
+
+int decode(JournalReader& reader, const Filter& filter)
+{
+    QTextStream output(stdout);
+    Netcom::JournalRecord record;
+    while (reader.next(&record))
+    {
+        if (!filter.accepts(record))
+        {
+            continue;
+        }
+
+        output << reader.wallClock(record).toString("yyyy-MM-dd hh:mm:ss.zzz")
+               << ' ' << QString::number(record.timestamp / 1000000.0, 'f', 3).rightJustified(16)
+               << ' ' << Netcom::eventName(record.event).leftJustified(11);
+        if (record.event == Netcom::JournalRecord::Event::Start)
+        {
+            output << " session " << reader.session() << endl;
+            continue;
+        }
+        output << ' ' << transportName(record.transport)
+               << ' ' << record.connection
+               << ' ' << Netcom::fromMappedAddress(record.address).toString() << ':' << record.port
+               << ' ' << (record.codec == Netcom::Message::Codec::Binary ? "binary" : "xml");
+        if (record.event == Netcom::JournalRecord::Event::Request)
+        {
+            output << " generation=" << record.generation;
+        }
+        output << endl;
+    }
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @class Replayer
+ * @brief Воспроизведение событий журнала: для каждого подключения из журнала открывается собственный сокет,
+ *        через который серверу отправляются те же запросы.
+ */
+class Replayer
+{
+public:
+    Replayer(QAbstractSocket::SocketType transport, const QHostAddress& address, quint16 port) :
+        m_transport(transport),
+        m_address(address),
+        m_port(port)
+    {
+
+    }
+
+    ~Replayer()
+    {
+        qDeleteAll(m_sockets);
+    }
+
+    void replay(const Netcom::JournalRecord& record, int session)
+    {
+        Key key(session, record.connection);
+        switch (record.event)
+        {
+        case Netcom::JournalRecord::Event::Connect:
+            socket(key);
+            break;
+        case Netcom::JournalRecord::Event::Subscribe:
+            send(key, Netcom::Message::Type::Subscribe, record.codec);
+            break;
+        case Netcom::JournalRecord::Event::Unsubscribe:
+            send(key, Netcom::Message::Type::Unsubscribe, record.codec);
+            break;
+        case Netcom::JournalRecord::Event::Request:
+            // поколение из журнала относится к прежнему запуску сервера, поэтому запрашивается полный список.
+            send(key, Netcom::Message::Type::InfoRequest, record.codec);
+            break;
+        case Netcom::JournalRecord::Event::Disconnect:
+            disconnect(key, record.codec);
+            break;
+        case Netcom::JournalRecord::Event::Start:
+        default:
+            break;
+        }
+    }
+
+    /**
+     * @brief wait - обслуживает сокеты в течение msec миллисекунд.
+     */
+    void wait(int msec)
+    {
+        QEventLoop loop;
+        QTimer::singleShot(qMax(0, msec), &loop, SLOT(quit()));
+        loop.exec();
+    }
+
+    int sent() const { return m_sent; }
+
+    int connections() const { return m_connections; }
+
+private:
+    typedef QPair<int, quint64> Key; //!< номер сеанса и идентификатор подключения в нём.
+
+    QAbstractSocket* socket(const Key& key)
+    {
+        QHash<Key, QAbstractSocket*>::const_iterator founded = m_sockets.constFind(key);
+        if (founded != m_sockets.constEnd())
+        {
+            return founded.value();
+        }
+
+        QAbstractSocket* result = nullptr;
+        if (m_transport == QAbstractSocket::UdpSocket)
+        {
+            QUdpSocket* udp = new QUdpSocket();
+            if (!udp->bind(m_address.protocol() == QAbstractSocket::IPv6Protocol ? QHostAddress(QHostAddress::AnyIPv6)
+                                                                                 : QHostAddress(QHostAddress::AnyIPv4),
+                           0))
+            {
+                qWarning().noquote() << udp->errorString();
+                delete udp;
+                return nullptr;
+            }
+            // ответы сервера не нужны, но вычитываются, чтобы не переполнять буфер сокета.
+            QObject::connect(udp, &QUdpSocket::readyRead,
+                             [udp]()
+                             {
+                                 QByteArray datagram;
+                                 while (udp->hasPendingDatagrams())
+                                 {
+                                     datagram.resize(static_cast<int>(qMax<qint64>(0, udp->pendingDatagramSize())));
+                                     udp->readDatagram(datagram.data(), datagram.size());
+                                 }
+                             });
+            result = udp;
+        }
+        else
+        {
+            QTcpSocket* tcp = new QTcpSocket();
+            tcp->connectToHost(m_address, m_port);
+            if (!tcp->waitForConnected(::connectTimeoutMsec()))
+            {
+                qWarning().noquote() << tcp->errorString();
+                delete tcp;
+                return nullptr;
+            }
+            QObject::connect(tcp, &QTcpSocket::readyRead,
+                             [tcp]() { tcp->readAll(); });
+            result = tcp;
+        }
+
+        ++m_connections;
+        m_sockets.insert(key, result);
+        return result;
+    }
+
+    void send(const Key& key, Netcom::Message::Type type, Netcom::Message::Codec codec)
+    {
+        QAbstractSocket* target = socket(key);
+        if (target == nullptr)
+        {
+            return;
+        }
+
+        Netcom::Message message(type);
+        message.setBackwardPort(target->localPort());
+        message.setPreferredCodec(codec);
+        QByteArray frame;
+        {
+            QDataStream output(&frame, QIODevice::WriteOnly);
+            output << message;
+        }
+
+        if (m_transport == QAbstractSocket::UdpSocket)
+        {
+            static_cast<QUdpSocket*>(target)->writeDatagram(frame, m_address, m_port);
+        }
+        else
+        {
+            target->write(frame);
+        }
+        ++m_sent;
+    }
+
+    void disconnect(const Key& key, Netcom::Message::Codec codec)
+    {
+        if (!m_sockets.contains(key))
+        {
+            return;
+        }
+        // UDP-сервер удаляет подписчика по запросу Unsubscribe.
+        if (m_transport == QAbstractSocket::UdpSocket)
+        {
+            send(key, Netcom::Message::Type::Unsubscribe, codec);
+        }
+
+        QAbstractSocket* each = m_sockets.take(key);
+        each->disconnectFromHost();
+        each->deleteLater();
+    }
+
+private:
+    QAbstractSocket::SocketType m_transport; //!< транспорт воспроизведения.
+    QHostAddress m_address;                  //!< адрес сервера.
+    quint16 m_port;                          //!< порт сервера.
+    QHash<Key, QAbstractSocket*> m_sockets;  //!< сокеты воспроизводимых подключений.
+    int m_sent = 0;                          //!< количество отправленных запросов.
+    int m_connections = 0;                   //!< количество открытых подключений.
+
+};
+
+int replay(JournalReader& reader, const Filter& filter, const QUrl& target, double speed)
+{
+    QAbstractSocket::SocketType transport = (target.scheme().toLower() == "udp" ? QAbstractSocket::UdpSocket
+                                                                                : QAbstractSocket::TcpSocket);
+    QHostAddress address = (target.host() == "localhost" ? QHostAddress(QHostAddress::LocalHost)
+                                                         : QHostAddress(target.host()));
+    Replayer replayer(transport, address, static_cast<quint16>(target.port()));
+
+    QElapsedTimer clock;
+    clock.start();
+    // время воспроизведения продолжается между сеансами записи.
+    qint64 sessionOffset = 0;
+    qint64 lastMsec = 0;
+
+    Netcom::JournalRecord record;
+    while (reader.next(&record))
+    {
+        qint64 recordMsec = static_cast<qint64>(record.timestamp / 1000000);
+        if (record.event == Netcom::JournalRecord::Event::Start)
+        {
+            sessionOffset = lastMsec;
+        }
+        recordMsec += sessionOffset;
+        lastMsec = recordMsec;
+
+        if (!filter.accepts(record))
+        {
+            continue;
+        }
+
+        if (speed > 0.0)
+        {
+            qint64 due = static_cast<qint64>(recordMsec / speed);
+            if (due > clock.elapsed())
+            {
+                replayer.wait(static_cast<int>(due - clock.elapsed()));
+            }
+        }
+        replayer.replay(record, reader.session());
+    }
+
+    replayer.wait(::drainTimeoutMsec());
+    qInfo().noquote() << QCoreApplication::translate("main", "Replayed %1 requests over %2 connections in %3 ms")
+                         .arg(replayer.sent())
+                         .arg(replayer.connections())
+                         .arg(clock.elapsed());
+    return EXIT_SUCCESS;
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    app.setApplicationName(app.tr("Netcom Journal Tool"));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(app.tr("Decodes, filters and replays the binary event journal written by the server (server --journal)."));
+    parser.addHelpOption();
+    parser.addPositionalArgument("journal", app.tr("Journal filename."));
+
+    QCommandLineOption eventOption(QStringList({ "e", "event" }),
+                                   app.tr("Select only events (comma separated): connect, disconnect, subscribe, unsubscribe, request"),
+                                   app.tr("events"));
+    parser.addOption(eventOption);
+
+    QCommandLineOption addressOption(QStringList({ "a", "address" }),
+                                     app.tr("Select only events of the client with the address"),
+                                     app.tr("address"));
+    parser.addOption(addressOption);
+
+    QCommandLineOption transportOption(QStringList({ "t", "transport" }),
+                                       app.tr("Select only events recorded by the tcp or udp server"),
+                                       app.tr("transport"));
+    parser.addOption(transportOption);
+
+    QCommandLineOption connectionOption(QStringList({ "c", "connection" }),
+                                        app.tr("Select only events of the connection id"),
+                                        app.tr("id"));
+    parser.addOption(connectionOption);
+
+    QCommandLineOption replayOption(QStringList({ "r", "replay" }),
+                                    app.tr("Replay the selected events against the server: <protocol>://<address>:<port>"),
+                                    app.tr("url"));
+    parser.addOption(replayOption);
+
+    QCommandLineOption speedOption(QStringList({ "s", "speed" }),
+                                   app.tr("Replay speed factor relative to the recorded timing (0 - as fast as possible)"),
+                                   app.tr("factor"),
+                                   "1");
+    parser.addOption(speedOption);
+
+    parser.process(app);
+
+    const QStringList args = parser.positionalArguments();
+    if (args.size() != 1)
+    {
+        parser.showHelp(EXIT_FAILURE);
+    }
+
+    Filter filter;
+    if (parser.isSet(eventOption))
+    {
+        for (const QString& each : parser.value(eventOption).split(',', QString::SkipEmptyParts))
+        {
+            bool ok = false;
+            Netcom::JournalRecord::Event event = Netcom::eventFromName(each.trimmed(), &ok);
+            if (!ok)
+            {
+                qCritical().noquote() << app.tr("Invalid event: %1.").arg(each);
+                parser.showHelp(EXIT_FAILURE);
+            }
+            filter.events.insert(event);
+        }
+    }
+    if (parser.isSet(addressOption))
+    {
+        QHostAddress address(parser.value(addressOption));
+        if (address.isNull())
+        {
+            qCritical().noquote() << app.tr("Invalid address: %1.").arg(parser.value(addressOption));
+            parser.showHelp(EXIT_FAILURE);
+        }
+        filter.hasAddress = true;
+        Netcom::toMappedAddress(address, filter.address);
+    }
+    if (parser.isSet(transportOption))
+    {
+        QString transport = parser.value(transportOption).toLower();
+        if (transport != "tcp" && transport != "udp")
+        {
+            qCritical().noquote() << app.tr("Invalid transport: %1.").arg(parser.value(transportOption));
+            parser.showHelp(EXIT_FAILURE);
+        }
+        filter.transport = (transport == "tcp" ? QAbstractSocket::TcpSocket
+                                               : QAbstractSocket::UdpSocket);
+    }
+    if (parser.isSet(connectionOption))
+    {
+        filter.connection = parser.value(connectionOption).toULongLong(&filter.hasConnection);
+        if (!filter.hasConnection)
+        {
+            qCritical().noquote() << app.tr("Invalid connection id: %1.").arg(parser.value(connectionOption));
+            parser.showHelp(EXIT_FAILURE);
+        }
+    }
+
+    bool ok = false;
+    double speed = parser.value(speedOption).toDouble(&ok);
+    if (!ok || speed < 0.0)
+    {
+        qCritical().noquote() << app.tr("Invalid replay speed: %1.").arg(parser.value(speedOption));
+        parser.showHelp(EXIT_FAILURE);
+    }
+
+    JournalReader reader;
+    QString error;
+    if (!reader.open(args.first(), &error))
+    {
+        qWarning().noquote() << error;
+        return EXIT_FAILURE;
+    }
+
+    if (!parser.isSet(replayOption))
+    {
+        return decode(reader, filter);
+    }
+
+    QUrl target(parser.value(replayOption));
+    if (   !target.isValid()
+        || target.port() <= 0
+        || (target.scheme().toLower() != "tcp" && target.scheme().toLower() != "udp"))
+    {
+        qCritical().noquote() << app.tr("Invalid replay url: %1.").arg(parser.value(replayOption));
+        parser.showHelp(EXIT_FAILURE);
+    }
+    return replay(reader, filter, target, speed);
+}
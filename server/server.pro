@@ -19,10 +19,19 @@ OBJECTS_DIR = $$PWD/build/obj
 MOC_DIR = $$PWD/build/moc
 
 SOURCES += \
+    src/addresstable.cpp \
+    src/journal.cpp \
+    src/logwriter.cpp \
+    src/nativesocket.cpp \
     src/server.cpp \
     src/main.cpp
 
 HEADERS += \
+    src/addresstable.h \
+    src/connectiontable.h \
+    src/journal.h \
+    src/logwriter.h \
+    src/nativesocket.h \
     src/server.h
 
 # installs
@@ -33,4 +42,5 @@ INSTALLS += \
 
 INCLUDEPATH += $$PREFIX/include
 
-LIBS += -L$$PREFIX/lib -lprotocol
+LIBS += -L$$PREFIX/lib -lprotocol \
+        -lz
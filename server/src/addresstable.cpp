@@ -0,0 +1,55 @@
+#include "addresstable.h"
+
+#include <cstring>
+
+#include <QHostAddress>
+
+#include <protocol.h>
+
+namespace
+{
+
+quint32 mix(quint32 hash, quint32 value)
+{
+    hash ^= value;
+    hash *= 0x85EBCA6Bu;
+    return hash ^ (hash >> 13);
+}
+
+}
+
+namespace Netcom
+{
+
+AddressKey::AddressKey(const QHostAddress& a, quint16 p) :
+    port(p)
+{
+    toMappedAddress(a, address);
+}
+
+bool AddressKey::operator== (const AddressKey& rhs) const
+{
+    return (   port == rhs.port
+            && std::memcmp(address, rhs.address, sizeof(address)) == 0);
+}
+
+bool AddressKey::operator!= (const AddressKey& rhs) const
+{
+    return !(*this == rhs);
+}
+
+uint AddressKey::hash(uint seed) const
+{
+    quint32 result = static_cast<quint32>(seed) ^ 0x9E3779B9u;
+    for (std::size_t i = 0; i < sizeof(address); i += sizeof(quint32))
+    {
+        quint32 word = 0;
+        std::memcpy(&word, address + i, sizeof(word));
+        result = ::mix(result, word);
+    }
+    result = ::mix(result, port);
+    result *= 0xC2B2AE35u;
+    return result ^ (result >> 16);
+}
+
+} // Netcom
@@ -0,0 +1,194 @@
+#ifndef NETCOM_ADDRESS_TABLE_H
+#define NETCOM_ADDRESS_TABLE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include <QtGlobal>
+
+class QHostAddress;
+
+namespace Netcom
+{
+
+/**
+ * @struct AddressKey
+ * @brief  Двоичное представление адреса и порта клиента для поиска и хэширования без формирования строк.
+ *
+ * @note   IPv4-адрес хранится как IPv4-mapped IPv6 (::ffff:a.b.c.d), поэтому адреса обоих семейств
+ *         сравниваются одним memcmp.
+ */
+struct AddressKey
+{
+    quint8 address[16] = {}; //!< адрес клиента.
+    quint16 port = 0;        //!< порт клиента.
+
+    AddressKey() = default;
+    AddressKey(const QHostAddress& a, quint16 p);
+
+    bool operator== (const AddressKey& rhs) const;
+    bool operator!= (const AddressKey& rhs) const;
+
+    /**
+     * @brief  hash - возвращает хэш адреса и порта.
+     * @param  seed - начальное значение.
+     */
+    uint hash(uint seed = 0) const;
+};
+
+/**
+ * @class AddressTable
+ * @brief Таблица значений, индексируемых адресом и портом клиента: открытая адресация с линейным пробированием
+ *        в одном непрерывном массиве.
+ *
+ * @note  Ссылки на значения остаются действительными до следующего вызова insert, remove или clear.
+ *        Удаление сдвигает следующие записи цепочки назад, поэтому пометки удалённых записей не нужны.
+ */
+template <typename T>
+class AddressTable
+{
+public:
+    /**
+     * @brief  find - ищет значение по адресу.
+     * @return значение, nullptr - если адреса нет в таблице.
+     */
+    T* find(const AddressKey& key)
+    {
+        if (m_size == 0)
+        {
+            return nullptr;
+        }
+        Slot& slot = m_slots[position(key, key.hash())];
+        return (slot.used ? &slot.value
+                          : nullptr);
+    }
+
+    /**
+     * @brief  insert - возвращает значение по адресу, добавляя значение по умолчанию, если адреса нет в таблице.
+     */
+    T& insert(const AddressKey& key)
+    {
+        if ((m_size + 1) * 2 > static_cast<int>(m_slots.size()))
+        {
+            grow();
+        }
+
+        const uint hash = key.hash();
+        Slot& slot = m_slots[position(key, hash)];
+        if (!slot.used)
+        {
+            slot.key = key;
+            slot.hash = hash;
+            slot.used = true;
+            ++m_size;
+        }
+        return slot.value;
+    }
+
+    /**
+     * @brief  remove - удаляет значение по адресу.
+     * @return false - если адреса нет в таблице.
+     */
+    bool remove(const AddressKey& key)
+    {
+        if (m_size == 0)
+        {
+            return false;
+        }
+
+        const std::size_t mask = m_slots.size() - 1;
+        std::size_t hole = position(key, key.hash());
+        if (!m_slots[hole].used)
+        {
+            return false;
+        }
+
+        // записи, которые при вставке прошли через освободившуюся ячейку, сдвигаются на её место.
+        for (std::size_t next = (hole + 1) & mask; m_slots[next].used; next = (next + 1) & mask)
+        {
+            const std::size_t home = m_slots[next].hash & mask;
+            const bool movable = (hole <= next ? (home <= hole || home > next)
+                                               : (home <= hole && home > next));
+            if (movable)
+            {
+                m_slots[hole] = std::move(m_slots[next]);
+                hole = next;
+            }
+        }
+        m_slots[hole] = Slot();
+        --m_size;
+        return true;
+    }
+
+    /**
+     * @brief clear - удаляет все значения и освобождает память.
+     */
+    void clear()
+    {
+        std::vector<Slot>().swap(m_slots);
+        m_size = 0;
+    }
+
+    /**
+     * @brief  size - возвращает количество значений в таблице.
+     */
+    int size() const
+    {
+        return m_size;
+    }
+
+private:
+    /**
+     * @struct Slot
+     * @brief  Ячейка таблицы.
+     */
+    struct Slot
+    {
+        AddressKey key;    //!< адрес.
+        uint hash = 0;     //!< хэш адреса.
+        bool used = false; //!< ячейка занята.
+        T value;           //!< значение.
+    };
+
+    /**
+     * @brief  position - возвращает ячейку с адресом key или первую свободную ячейку его цепочки.
+     */
+    std::size_t position(const AddressKey& key, uint hash) const
+    {
+        const std::size_t mask = m_slots.size() - 1;
+        std::size_t index = hash & mask;
+        while (   m_slots[index].used
+               && (m_slots[index].hash != hash || m_slots[index].key != key))
+        {
+            index = (index + 1) & mask;
+        }
+        return index;
+    }
+
+    /**
+     * @brief grow - увеличивает таблицу вдвое (заполненность не превышает половины).
+     */
+    void grow()
+    {
+        std::vector<Slot> previous(std::max<std::size_t>(m_slots.size() * 2, 16));
+        previous.swap(m_slots);
+        for (Slot& each : previous)
+        {
+            if (each.used)
+            {
+                m_slots[position(each.key, each.hash)] = std::move(each);
+            }
+        }
+    }
+
+private:
+    std::vector<Slot> m_slots; //!< ячейки (количество - степень двойки).
+    int m_size = 0;            //!< количество занятых ячеек.
+
+};
+
+} // Netcom
+
+#endif // NETCOM_ADDRESS_TABLE_H
@@ -0,0 +1,325 @@
+#ifndef NETCOM_CONNECTION_TABLE_H
+#define NETCOM_CONNECTION_TABLE_H
+
+#include <algorithm>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include <QtGlobal>
+
+namespace Netcom
+{
+
+/**
+ * @brief ConnectionId - идентификатор активного подключения (TCP-соединения или UDP-подписчика).
+ *
+ * @note  Идентификатор выдаёт ConnectionTable: младшие 32 бита - номер дескриптора, старшие - поколение дескриптора.
+ *        Поколение меняется при каждом освобождении дескриптора, поэтому кадр, доставленный обработчику
+ *        после отключения клиента, не попадёт другому клиенту. 0 - недействительный идентификатор.
+ */
+typedef quint64 ConnectionId;
+
+/**
+ * @brief connectionHandle - возвращает номер дескриптора подключения.
+ *
+ * @note  Номера дескрипторов невелики и используются повторно, поэтому по ним можно индексировать массивы
+ *        (сверяя идентификатор подключения целиком, чтобы не спутать его с прежним владельцем дескриптора).
+ */
+inline int connectionHandle(ConnectionId id)
+{
+    return static_cast<int>(id & 0xFFFFFFFFu);
+}
+
+/**
+ * @class ConnectionTable
+ * @brief Таблица активных подключений: значения хранятся в плотном массиве ячеек без промежутков,
+ *        идентификатор подключения указывает на дескриптор, хранящий номер ячейки.
+ *
+ * @note  Поиск, добавление и удаление по идентификатору не используют хэш-таблицу: номер дескриптора
+ *        берётся из идентификатора, освободившиеся дескрипторы используются повторно (список свободных дескрипторов).
+ *        При удалении на место ячейки переносится последняя, поэтому обход массива идёт в произвольном порядке.
+ *        Порядок по времени подключения хранит отдельный индекс, отсортированный по времени (см. forEachSince).
+ *
+ *        Сложность (n - количество подключений):
+ *        - find - O(1);
+ *        - insert - амортизированно O(1), если время не меньше, чем у предыдущих подключений,
+ *          и O(n) на сдвиг индекса по времени, если системные часы перевели назад;
+ *        - take - O(log n) на поиск в индексе по времени и амортизированно O(1) на его уплотнение:
+ *          уплотнение за O(n) выполняется не чаще, чем через n удалений.
+ *        Перестроений, как у хэш-таблицы, нет, но отдельные вызовы insert и take могут занимать O(n).
+ */
+template <typename T>
+class ConnectionTable
+{
+    /**
+     * @struct Slot
+     * @brief  Ячейка таблицы.
+     */
+    struct Slot
+    {
+        ConnectionId id = 0; //!< идентификатор подключения.
+        qint64 time = 0;     //!< время подключения.
+        T value;             //!< значение.
+    };
+
+    /**
+     * @struct Handle
+     * @brief  Дескриптор подключения.
+     */
+    struct Handle
+    {
+        quint32 generation = 1; //!< поколение дескриптора (не 0, поэтому идентификатор не бывает 0).
+        int slot = -1;          //!< номер ячейки (-1 - дескриптор свободен).
+        int nextFree = -1;      //!< следующий свободный дескриптор.
+    };
+
+    /**
+     * @struct TimeEntry
+     * @brief  Элемент индекса по времени подключения.
+     */
+    struct TimeEntry
+    {
+        qint64 time = 0;     //!< время подключения.
+        ConnectionId id = 0; //!< идентификатор подключения (0 - подключение удалено).
+    };
+
+public:
+    /**
+     * @class const_iterator
+     * @brief Обход значений по массиву ячеек.
+     */
+    class const_iterator
+    {
+    public:
+        explicit const_iterator(typename std::vector<Slot>::const_iterator slot) :
+            m_slot(slot)
+        {
+
+        }
+
+        ConnectionId key() const { return m_slot->id; }
+        const T& value() const { return m_slot->value; }
+        const T& operator* () const { return value(); }
+
+        const_iterator& operator++ ()
+        {
+            ++m_slot;
+            return *this;
+        }
+
+        bool operator== (const const_iterator& rhs) const { return m_slot == rhs.m_slot; }
+        bool operator!= (const const_iterator& rhs) const { return m_slot != rhs.m_slot; }
+
+    private:
+        typename std::vector<Slot>::const_iterator m_slot; //!< текущая ячейка.
+    };
+
+    const_iterator begin() const { return const_iterator(m_slots.cbegin()); }
+    const_iterator end() const { return const_iterator(m_slots.cend()); }
+
+    /**
+     * @brief  forEachSince - обходит значения в порядке времени подключения, начиная с заданного времени.
+     * @param  time - наименьшее время подключения.
+     * @param  function - обработчик значения, возвращает false, чтобы прервать обход.
+     *
+     * @note   Начало обхода находится двоичным поиском по индексу, поэтому подключения раньше time не просматриваются.
+     */
+    template <typename Function>
+    void forEachSince(qint64 time, const Function& function) const
+    {
+        for (typename std::vector<TimeEntry>::const_iterator it = lowerBound(time); it != m_byTime.cend(); ++it)
+        {
+            if (   it->id != 0
+                && !function(m_slots[m_handles[connectionHandle(it->id)].slot].value))
+            {
+                break;
+            }
+        }
+    }
+
+    /**
+     * @brief  find - ищет значение по идентификатору подключения.
+     * @return значение, nullptr - если подключения нет в таблице.
+     */
+    T* find(ConnectionId id)
+    {
+        int index = slotIndex(id);
+        return (index >= 0 ? &m_slots[index].value
+                           : nullptr);
+    }
+
+    const T* find(ConnectionId id) const
+    {
+        int index = slotIndex(id);
+        return (index >= 0 ? &m_slots[index].value
+                           : nullptr);
+    }
+
+    /**
+     * @brief  insert - добавляет значение в таблицу.
+     * @param  time - время подключения (ключ индекса по времени).
+     * @param  value - значение.
+     * @return идентификатор подключения.
+     *
+     * @note   Время обычно не меньше, чем у предыдущих подключений, и элемент индекса добавляется в конец
+     *         (амортизированно O(1)). Если системные часы перевели назад, элемент вставляется на своё место
+     *         со сдвигом более поздних элементов (O(n)).
+     */
+    ConnectionId insert(qint64 time, const T& value)
+    {
+        int handle = m_free;
+        if (handle >= 0)
+        {
+            m_free = m_handles[handle].nextFree;
+        }
+        else
+        {
+            handle = static_cast<int>(m_handles.size());
+            m_handles.emplace_back();
+        }
+        Handle& each = m_handles[handle];
+        each.slot = static_cast<int>(m_slots.size());
+        each.nextFree = -1;
+
+        Slot slot;
+        slot.id = (static_cast<ConnectionId>(each.generation) << 32) | static_cast<quint32>(handle);
+        slot.time = time;
+        slot.value = value;
+        m_slots.push_back(std::move(slot));
+
+        TimeEntry entry;
+        entry.time = time;
+        entry.id = m_slots.back().id;
+        if (   m_byTime.empty()
+            || m_byTime.back().time <= time)
+        {
+            m_byTime.push_back(entry);
+        }
+        else
+        {
+            m_byTime.insert(std::upper_bound(m_byTime.begin(), m_byTime.end(), entry,
+                                             [](const TimeEntry& lhs, const TimeEntry& rhs)
+                                             {
+                                                 return lhs.time < rhs.time;
+                                             }),
+                            entry);
+        }
+        return entry.id;
+    }
+
+    /**
+     * @brief  take - удаляет значение из таблицы.
+     * @param  id - идентификатор подключения.
+     * @param  value - удалённое значение.
+     * @return false - если подключения нет в таблице.
+     *
+     * @note   O(log n) и амортизированно O(1) на уплотнение индекса по времени (см. eraseFromTimeIndex).
+     */
+    bool take(ConnectionId id, T* value)
+    {
+        const int index = slotIndex(id);
+        if (index < 0)
+        {
+            return false;
+        }
+
+        Slot& slot = m_slots[index];
+        if (value != nullptr)
+        {
+            *value = std::move(slot.value);
+        }
+        eraseFromTimeIndex(slot.time, id);
+
+        // последняя ячейка переносится на место удалённой, массив остаётся без промежутков.
+        if (index + 1 < static_cast<int>(m_slots.size()))
+        {
+            slot = std::move(m_slots.back());
+            m_handles[connectionHandle(slot.id)].slot = index;
+        }
+        m_slots.pop_back();
+
+        const int handle = connectionHandle(id);
+        Handle& each = m_handles[handle];
+        each.slot = -1;
+        each.generation = (each.generation == std::numeric_limits<quint32>::max() ? 1
+                                                                                 : each.generation + 1);
+        each.nextFree = m_free;
+        m_free = handle;
+        return true;
+    }
+
+    /**
+     * @brief  size - возвращает количество подключений в таблице.
+     */
+    int size() const
+    {
+        return static_cast<int>(m_slots.size());
+    }
+
+private:
+    /**
+     * @brief  slotIndex - возвращает номер ячейки подключения (-1 - подключения нет в таблице).
+     */
+    int slotIndex(ConnectionId id) const
+    {
+        const int handle = connectionHandle(id);
+        if (   handle >= static_cast<int>(m_handles.size())
+            || m_handles[handle].generation != static_cast<quint32>(id >> 32))
+        {
+            return -1;
+        }
+        return m_handles[handle].slot;
+    }
+
+    typename std::vector<TimeEntry>::const_iterator lowerBound(qint64 time) const
+    {
+        return std::lower_bound(m_byTime.cbegin(), m_byTime.cend(), time, [](const TimeEntry& lhs, qint64 rhs)
+        {
+            return lhs.time < rhs;
+        });
+    }
+
+    /**
+     * @brief eraseFromTimeIndex - помечает элемент индекса по времени удалённым.
+     *
+     * @note  Удалённые элементы не сдвигают индекс и пропускаются при обходе; индекс уплотняется за O(n),
+     *        когда удалённых элементов становится больше, чем подключений. После уплотнения до следующего
+     *        нужно не меньше n удалений, поэтому в пересчёте на одно удаление уплотнение стоит O(1).
+     */
+    void eraseFromTimeIndex(qint64 time, ConnectionId id)
+    {
+        typename std::vector<TimeEntry>::iterator it = m_byTime.begin() + (lowerBound(time) - m_byTime.cbegin());
+        for (; it != m_byTime.end() && it->time == time; ++it)
+        {
+            if (it->id == id)
+            {
+                it->id = 0;
+                ++m_erasedByTime;
+                break;
+            }
+        }
+
+        if (m_erasedByTime > m_slots.size())
+        {
+            m_byTime.erase(std::remove_if(m_byTime.begin(), m_byTime.end(), [](const TimeEntry& each)
+                                          {
+                                              return each.id == 0;
+                                          }),
+                           m_byTime.end());
+            m_erasedByTime = 0;
+        }
+    }
+
+private:
+    std::vector<Slot> m_slots;       //!< занятые ячейки без промежутков.
+    std::vector<Handle> m_handles;   //!< дескрипторы подключений (занятые и свободные).
+    std::vector<TimeEntry> m_byTime; //!< индекс подключений, отсортированный по времени подключения.
+    std::size_t m_erasedByTime = 0;  //!< количество удалённых элементов в индексе по времени.
+    int m_free = -1;                 //!< первый свободный дескриптор.
+
+};
+
+} // Netcom
+
+#endif // NETCOM_CONNECTION_TABLE_H
@@ -0,0 +1,251 @@
+#include "journal.h"
+
+#include <cstring>
+
+#include <QDateTime>
+#include <QHash>
+#include <QMutexLocker>
+#include <QtEndian>
+
+namespace
+{
+
+int bufferedRecords() { return 256; }
+
+int flushIntervalMsec() { return 1000; }
+
+const quint8 journalVersion = 1; //!< версия формата журнала.
+
+quint8 transportTag(QAbstractSocket::SocketType transport)
+{
+    switch (transport)
+    {
+    case QAbstractSocket::TcpSocket:
+        return 1;
+    case QAbstractSocket::UdpSocket:
+        return 2;
+    default:
+        break;
+    }
+    return 0;
+}
+
+QAbstractSocket::SocketType transportFromTag(quint8 tag)
+{
+    switch (tag)
+    {
+    case 1:
+        return QAbstractSocket::TcpSocket;
+    case 2:
+        return QAbstractSocket::UdpSocket;
+    default:
+        break;
+    }
+    return QAbstractSocket::UnknownSocketType;
+}
+
+}
+
+namespace Netcom
+{
+
+void JournalRecord::encode(char* to) const
+{
+    uchar* raw = reinterpret_cast<uchar*>(to);
+    std::memset(raw, 0, Size);
+
+    qToLittleEndian<quint64>(timestamp, raw);
+    qToLittleEndian<quint64>(connection, raw + 8);
+    qToLittleEndian<quint64>(generation, raw + 16);
+
+    std::memcpy(raw + 24, address, sizeof(address));
+
+    qToLittleEndian<quint16>(port, raw + 40);
+    raw[42] = static_cast<quint8>(event);
+    raw[43] = ::transportTag(transport);
+    raw[44] = static_cast<quint8>(codec);
+}
+
+bool JournalRecord::decode(const char* from)
+{
+    const uchar* raw = reinterpret_cast<const uchar*>(from);
+
+    timestamp = qFromLittleEndian<quint64>(raw);
+    connection = qFromLittleEndian<quint64>(raw + 8);
+    generation = qFromLittleEndian<quint64>(raw + 16);
+
+    std::memcpy(address, raw + 24, sizeof(address));
+
+    port = qFromLittleEndian<quint16>(raw + 40);
+    if (raw[42] > static_cast<quint8>(Event::Request))
+    {
+        return false;
+    }
+    event = static_cast<Event>(raw[42]);
+    transport = ::transportFromTag(raw[43]);
+    codec = (raw[44] == static_cast<quint8>(Message::Codec::Binary) ? Message::Codec::Binary
+                                                                     : Message::Codec::Xml);
+    return true;
+}
+
+QString eventName(JournalRecord::Event event)
+{
+    switch (event)
+    {
+    case JournalRecord::Event::Start:
+        return "start";
+    case JournalRecord::Event::Connect:
+        return "connect";
+    case JournalRecord::Event::Disconnect:
+        return "disconnect";
+    case JournalRecord::Event::Subscribe:
+        return "subscribe";
+    case JournalRecord::Event::Unsubscribe:
+        return "unsubscribe";
+    case JournalRecord::Event::Request:
+        return "request";
+    default:
+        break;
+    }
+    return QString::null;
+}
+
+JournalRecord::Event eventFromName(const QString& name, bool* ok)
+{
+    static const QHash<QString, JournalRecord::Event> events({ { "start",       JournalRecord::Event::Start },
+                                                               { "connect",     JournalRecord::Event::Connect },
+                                                               { "disconnect",  JournalRecord::Event::Disconnect },
+                                                               { "subscribe",   JournalRecord::Event::Subscribe },
+                                                               { "unsubscribe", JournalRecord::Event::Unsubscribe },
+                                                               { "request",     JournalRecord::Event::Request }
+                                                             });
+    QHash<QString, JournalRecord::Event>::const_iterator founded = events.constFind(name.toLower());
+    if (ok != nullptr)
+    {
+        *ok = (founded != events.constEnd());
+    }
+    return (founded != events.constEnd() ? founded.value()
+                                         : JournalRecord::Event::Start);
+}
+
+QByteArray journalSignature()
+{
+    QByteArray result("NCJRNL", 6);
+    result.append('\0');
+    result.append(static_cast<char>(::journalVersion));
+    return result;
+}
+
+JournalWriter::JournalWriter() :
+    m_flushTimer(new QTimer())
+{
+    m_flushTimer->setInterval(::flushIntervalMsec());
+    QObject::connect(m_flushTimer.get(), &QTimer::timeout, [this]()
+    {
+        flushPending();
+    });
+}
+
+JournalWriter::~JournalWriter()
+{
+    close();
+}
+
+bool JournalWriter::open(const QString& fileName, QString* error)
+{
+    close();
+
+    QMutexLocker locker(&m_mutex);
+    m_file.setFileName(fileName);
+    if (!m_file.open(QFile::WriteOnly | QFile::Append))
+    {
+        if (error != nullptr)
+        {
+            *error = m_file.errorString();
+        }
+        return false;
+    }
+    if (m_file.size() == 0)
+    {
+        m_file.write(journalSignature());
+    }
+
+    m_buffer.clear();
+    m_buffer.reserve(::bufferedRecords() * JournalRecord::Size);
+    m_buffered = 0;
+    m_clock.start();
+    m_lastFlush = 0;
+    m_open.storeRelease(1);
+    m_flushTimer->start();
+    locker.unlock();
+
+    JournalRecord start;
+    start.event = JournalRecord::Event::Start;
+    start.generation = static_cast<quint64>(QDateTime::currentMSecsSinceEpoch());
+    append(start);
+    return true;
+}
+
+void JournalWriter::close()
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_open.loadAcquire() == 0)
+    {
+        return;
+    }
+    m_open.storeRelease(0);
+    m_flushTimer->stop();
+    flush();
+    m_file.close();
+}
+
+bool JournalWriter::isOpen() const
+{
+    return (m_open.loadAcquire() != 0);
+}
+
+void JournalWriter::append(JournalRecord record)
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_open.loadAcquire() == 0)
+    {
+        return;
+    }
+
+    // время устанавливается под блокировкой, поэтому записи в файле упорядочены по времени.
+    record.timestamp = static_cast<quint64>(m_clock.nsecsElapsed());
+    int position = m_buffer.size();
+    m_buffer.resize(position + JournalRecord::Size);
+    record.encode(m_buffer.data() + position);
+    ++m_buffered;
+
+    if (   m_buffered >= ::bufferedRecords()
+        || m_clock.elapsed() - m_lastFlush >= ::flushIntervalMsec())
+    {
+        flush();
+    }
+}
+
+void JournalWriter::flushPending()
+{
+    QMutexLocker locker(&m_mutex);
+    if (   m_open.loadAcquire() != 0
+        && !m_buffer.isEmpty())
+    {
+        flush();
+    }
+}
+
+void JournalWriter::flush()
+{
+    if (!m_buffer.isEmpty())
+    {
+        m_file.write(m_buffer);
+        m_file.flush();
+        m_buffer.resize(0);
+        m_buffered = 0;
+    }
+    m_lastFlush = m_clock.elapsed();
+}
+
+} // Netcom
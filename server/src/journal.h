@@ -0,0 +1,166 @@
+#ifndef NETCOM_JOURNAL_H
+#define NETCOM_JOURNAL_H
+
+#include <memory>
+
+#include <QAbstractSocket>
+#include <QAtomicInt>
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QHash>
+#include <QHostAddress>
+#include <QMutex>
+#include <QString>
+#include <QTimer>
+
+#include <protocol.h>
+
+namespace Netcom
+{
+
+/**
+ * @struct JournalRecord
+ * @brief  Запись двоичного журнала событий списка активных клиентов.
+ *
+ * @note  Формат файла журнала:
+ *        - заголовок: 8 байт сигнатуры "NCJRNL" с версией формата;
+ *        - последовательность записей фиксированного размера (Size байт, little-endian):
+ *          quint64 - время события, нс от начала сеанса записи (монотонное);
+ *          quint64 - идентификатор подключения;
+ *          quint64 - поколение из запроса (для Start - время начала сеанса, мс от начала эпохи);
+ *          16 байт - адрес клиента (в том же виде, что ClientInfo::address);
+ *          quint16 - порт клиента;
+ *          quint8  - событие, quint8 - транспорт, quint8 - предпочитаемый формат, 3 байта - резерв.
+ *        Каждый запуск сервера начинает новый сеанс записью Start.
+ */
+struct JournalRecord
+{
+    enum
+    {
+        Size = 48 //!< размер записи в файле.
+    };
+
+    /**
+     * @enum  Event
+     * @brief Тип события.
+     */
+    enum class Event : quint8
+    {
+        Start = 0,   //!< начало сеанса записи.
+        Connect,     //!< клиент добавлен в список активных.
+        Disconnect,  //!< клиент удалён из списка активных.
+        Subscribe,   //!< запрос Subscribe.
+        Unsubscribe, //!< запрос Unsubscribe.
+        Request      //!< запрос InfoRequest.
+    };
+
+    quint64 timestamp = 0;   //!< время события, нс от начала сеанса записи.
+    quint64 connection = 0;  //!< идентификатор подключения.
+    quint64 generation = 0;  //!< поколение списка клиентов из запроса.
+    quint8 address[16] = {}; //!< адрес клиента (в том же виде, что ClientInfo::address).
+    quint16 port = 0;        //!< порт клиента.
+    Event event = Event::Start; //!< событие.
+    QAbstractSocket::SocketType transport = QAbstractSocket::UnknownSocketType; //!< транспорт сервера.
+    Message::Codec codec = Message::Codec::Xml; //!< предпочитаемый клиентом формат.
+
+    /**
+     * @brief encode - записывает запись в буфер размером Size байт.
+     */
+    void encode(char* to) const;
+
+    /**
+     * @brief  decode - читает запись из буфера размером Size байт.
+     * @return false - если запись повреждена.
+     */
+    bool decode(const char* from);
+};
+
+/**
+ * @brief  eventName - возвращает название события для вывода и фильтрации ("connect", "request", ...).
+ */
+QString eventName(JournalRecord::Event event);
+
+/**
+ * @brief  eventFromName - возвращает событие по названию.
+ * @param  ok - признак того, что название известно.
+ */
+JournalRecord::Event eventFromName(const QString& name, bool* ok);
+
+/**
+ * @brief  journalSignature - сигнатура файла журнала.
+ */
+QByteArray journalSignature();
+
+/**
+ * @class JournalWriter
+ * @brief Запись журнала событий в файл только добавлением, через буфер (из любого потока).
+ *
+ * @note  Записи накапливаются в буфере и записываются в файл пакетом при его заполнении,
+ *        при закрытии журнала и по таймеру раз в flushIntervalMsec, поэтому запись попадает в файл
+ *        не позже чем через flushIntervalMsec, даже если за ней не следуют другие.
+ *        Таймер работает в потоке, открывшем журнал (в нём должен выполняться цикл событий).
+ */
+class JournalWriter
+{
+public:
+    JournalWriter();
+    ~JournalWriter();
+
+    /**
+     * @brief  open - открывает файл журнала на дозапись и начинает новый сеанс.
+     * @param  fileName - имя файла журнала.
+     * @param  error - текст сообщения об ошибке.
+     * @return флаг успешности открытия.
+     */
+    bool open(const QString& fileName, QString* error);
+
+    /**
+     * @brief close - записывает буфер и закрывает файл журнала.
+     */
+    void close();
+
+    /**
+     * @brief  isOpen - проверяет, ведётся ли журнал (без блокировки).
+     */
+    bool isOpen() const;
+
+    /**
+     * @brief append - добавляет запись в журнал, время события устанавливается журналом.
+     * @param record - добавляемая запись.
+     */
+    void append(JournalRecord record);
+
+private:
+    Q_DISABLE_COPY(JournalWriter)
+
+    /**
+     * @brief flush - записывает буфер в файл (под блокировкой m_mutex).
+     */
+    void flush();
+
+    /**
+     * @brief flushPending - записывает в файл накопленные записи (по таймеру).
+     */
+    void flushPending();
+
+private:
+    QMutex m_mutex;          //!< блокировка буфера и файла.
+    QAtomicInt m_open;       //!< признак открытого журнала.
+    QFile m_file;            //!< файл журнала.
+    QByteArray m_buffer;     //!< записи, ещё не записанные в файл.
+    int m_buffered = 0;      //!< количество записей в буфере.
+    QElapsedTimer m_clock;   //!< монотонное время сеанса записи.
+    qint64 m_lastFlush = 0;  //!< время последней записи в файл, мс от начала сеанса.
+    std::unique_ptr<QTimer> m_flushTimer; //!< таймер записи накопленных записей в файл.
+
+};
+
+inline uint qHash(JournalRecord::Event key, uint seed = 0)
+{
+    return ::qHash(static_cast<int>(key), seed);
+}
+
+} // Netcom
+
+#endif // NETCOM_JOURNAL_H
@@ -0,0 +1,574 @@
+#include "logwriter.h"
+
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QStringList>
+#include <QTextStream>
+
+#include <zlib.h>
+
+namespace
+{
+
+int flushLines() { return 256; }
+
+int flushIntervalMsec() { return 200; }
+
+int compressChunkSize() { return 64 * 1024; }
+
+/**
+ * @brief  utf8Size - возвращает размер строки в кодировке UTF-8 в байтах (без преобразования строки).
+ */
+qint64 utf8Size(const QString& text)
+{
+    qint64 result = 0;
+    for (int i = 0; i < text.size(); ++i)
+    {
+        const ushort code = text.at(i).unicode();
+        if (code < 0x80)
+        {
+            result += 1;
+        }
+        else if (code < 0x800)
+        {
+            result += 2;
+        }
+        else if (   QChar::isHighSurrogate(code)
+                 && i + 1 < text.size()
+                 && text.at(i + 1).isLowSurrogate())
+        {
+            // суррогатная пара - один символ из четырёх байт.
+            result += 4;
+            ++i;
+        }
+        else
+        {
+            result += 3;
+        }
+    }
+    return result;
+}
+
+/**
+ * @brief  severity - возвращает важность сообщения (значения QtMsgType не упорядочены по важности).
+ */
+int severity(QtMsgType type)
+{
+    switch (type)
+    {
+    case QtDebugMsg:
+        return 0;
+    case QtInfoMsg:
+        return 1;
+    case QtWarningMsg:
+        return 2;
+    case QtCriticalMsg:
+        return 3;
+    case QtFatalMsg:
+    default:
+        break;
+    }
+    return 4;
+}
+
+QString format(const Netcom::LogRecord& record)
+{
+    return QString("%1 - %2").arg(QDateTime::fromMSecsSinceEpoch(record.timestamp).toString("hh:mm:ss.zzz"))
+                             .arg(record.text);
+}
+
+void printToConsole(QtMsgType type, const QString& line)
+{
+    switch (type)
+    {
+    case QtDebugMsg:
+        qDebug().noquote() << line;
+        break;
+    case QtInfoMsg:
+        qInfo().noquote() << line;
+        break;
+    case QtWarningMsg:
+        qWarning().noquote() << line;
+        break;
+    case QtCriticalMsg:
+    default:
+        qCritical().noquote() << line;
+        break;
+    }
+}
+
+/**
+ * @class CompressTask
+ * @brief Сжатие сегмента журнала в gzip и удаление старых сжатых сегментов.
+ *
+ * @note  Сегмент сжимается порциями по compressChunkSize, поэтому память не зависит от размера сегмента.
+ */
+class CompressTask : public QRunnable
+{
+public:
+    /**
+     * @param segment - имя сегмента журнала.
+     * @param fileName - имя файла журнала, по которому находятся его сегменты.
+     * @param keepCount - количество хранимых сжатых сегментов (0 - хранить все).
+     */
+    CompressTask(const QString& segment, const QString& fileName, int keepCount) :
+        m_segment(segment),
+        m_fileName(fileName),
+        m_keepCount(keepCount)
+    {
+
+    }
+
+    virtual void run() override
+    {
+        QFile input(m_segment);
+        if (!input.open(QFile::ReadOnly))
+        {
+            qWarning().noquote() << input.errorString();
+            return;
+        }
+
+        const QString outputName = m_segment + ".gz";
+        gzFile output = gzopen(QFile::encodeName(outputName).constData(), "wb");
+        if (output == nullptr)
+        {
+            qWarning().noquote() << QString("Can't open %1").arg(outputName);
+            return;
+        }
+
+        QByteArray chunk(compressChunkSize(), Qt::Uninitialized);
+        bool ok = true;
+        while (ok && !input.atEnd())
+        {
+            const qint64 size = input.read(chunk.data(), chunk.size());
+            ok =    size >= 0
+                 && (size == 0 || gzwrite(output, chunk.constData(), static_cast<unsigned>(size)) == size);
+        }
+        ok = gzclose(output) == Z_OK && ok;
+        input.close();
+
+        if (!ok)
+        {
+            qWarning().noquote() << QString("Can't compress %1 to %2").arg(m_segment).arg(outputName);
+            QFile::remove(outputName);
+            return;
+        }
+        input.remove();
+
+        prune();
+    }
+
+private:
+    void prune()
+    {
+        if (m_keepCount <= 0)
+        {
+            return;
+        }
+
+        // время в имени сегмента записано так, что сортировка по имени совпадает с сортировкой по времени.
+        QFileInfo info(m_fileName);
+        QDir dir = info.absoluteDir();
+        QStringList segments = dir.entryList(QStringList(info.fileName() + ".*.gz"),
+                                             QDir::Files,
+                                             QDir::Name);
+        for (int i = 0; i < segments.size() - m_keepCount; ++i)
+        {
+            dir.remove(segments.at(i));
+        }
+    }
+
+private:
+    QString m_segment;  //!< имя сегмента журнала.
+    QString m_fileName; //!< имя файла журнала.
+    int m_keepCount;    //!< количество хранимых сжатых сегментов.
+
+};
+
+}
+
+namespace Netcom
+{
+
+LogQueue::LogQueue(std::size_t capacity)
+{
+    std::size_t size = 2;
+    while (size < capacity)
+    {
+        size <<= 1;
+    }
+
+    m_cells.reset(new Cell[size]);
+    m_mask = size - 1;
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        m_cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    m_enqueuePos.value.store(0, std::memory_order_relaxed);
+    m_dequeuePos.value.store(0, std::memory_order_relaxed);
+}
+
+LogQueue::~LogQueue()
+{
+
+}
+
+bool LogQueue::tryPush(LogRecord& record)
+{
+    std::size_t position = m_enqueuePos.value.load(std::memory_order_relaxed);
+    for (;;)
+    {
+        Cell& cell = m_cells[position & m_mask];
+        std::size_t sequence = cell.sequence.load(std::memory_order_acquire);
+        std::ptrdiff_t difference = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(position);
+        if (difference == 0)
+        {
+            if (m_enqueuePos.value.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+            {
+                cell.record.type = record.type;
+                cell.record.timestamp = record.timestamp;
+                cell.record.text.swap(record.text);
+                cell.sequence.store(position + 1, std::memory_order_release);
+                return true;
+            }
+        }
+        else if (difference < 0)
+        {
+            // ячейка ещё не прочитана: очередь заполнена.
+            return false;
+        }
+        else
+        {
+            position = m_enqueuePos.value.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+bool LogQueue::tryPop(LogRecord* record)
+{
+    Q_CHECK_PTR(record);
+
+    std::size_t position = m_dequeuePos.value.load(std::memory_order_relaxed);
+    for (;;)
+    {
+        Cell& cell = m_cells[position & m_mask];
+        std::size_t sequence = cell.sequence.load(std::memory_order_acquire);
+        std::ptrdiff_t difference = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(position + 1);
+        if (difference == 0)
+        {
+            if (m_dequeuePos.value.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+            {
+                record->type = cell.record.type;
+                record->timestamp = cell.record.timestamp;
+                record->text.swap(cell.record.text);
+                cell.record.text.clear();
+                cell.sequence.store(position + m_mask + 1, std::memory_order_release);
+                return true;
+            }
+        }
+        else if (difference < 0)
+        {
+            // ячейка ещё не записана: очередь пуста.
+            return false;
+        }
+        else
+        {
+            position = m_dequeuePos.value.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+std::size_t LogQueue::sizeApprox() const
+{
+    std::size_t enqueued = m_enqueuePos.value.load(std::memory_order_relaxed);
+    std::size_t dequeued = m_dequeuePos.value.load(std::memory_order_relaxed);
+    return (enqueued > dequeued ? enqueued - dequeued
+                                : 0);
+}
+
+LogWriter::LogWriter(std::size_t capacity) :
+    QThread(),
+    m_queue(capacity),
+    m_policy(static_cast<int>(OverflowPolicy::CountDrops)),
+    m_level(::severity(QtInfoMsg))
+{
+    // сегменты сжимаются по одному, чтобы удаление старых сегментов не пересекалось со сжатием.
+    m_compressor.setMaxThreadCount(1);
+}
+
+LogWriter::~LogWriter()
+{
+    stop();
+}
+
+void LogWriter::setFileName(const QString& fileName)
+{
+    QMutexLocker locker(&m_mutex);
+    m_fileName = fileName;
+}
+
+void LogWriter::setRotation(qint64 maxSize, int intervalSec, int keepCount)
+{
+    QMutexLocker locker(&m_mutex);
+    m_maxSize = qMax<qint64>(0, maxSize);
+    m_rotateIntervalSec = qMax(0, intervalSec);
+    m_keepCount = qMax(0, keepCount);
+}
+
+void LogWriter::setOverflowPolicy(OverflowPolicy policy)
+{
+    m_policy.storeRelease(static_cast<int>(policy));
+}
+
+void LogWriter::setLevel(QtMsgType level)
+{
+    m_level.storeRelease(::severity(level));
+}
+
+bool LogWriter::isEnabled(QtMsgType type) const
+{
+    return (::severity(type) >= m_level.loadAcquire());
+}
+
+void LogWriter::write(QtMsgType type, const QString& text)
+{
+    if (!isEnabled(type))
+    {
+        return;
+    }
+
+    LogRecord record;
+    record.type = type;
+    record.timestamp = QDateTime::currentMSecsSinceEpoch();
+    record.text = text;
+
+    while (!m_queue.tryPush(record))
+    {
+        switch (static_cast<OverflowPolicy>(m_policy.loadAcquire()))
+        {
+        case OverflowPolicy::Block:
+            {
+                // поток записи будит ожидающих под этой же блокировкой после каждого извлечённого пакета,
+                // поэтому место, освободившееся до её захвата, видно повторной попытке.
+                QMutexLocker locker(&m_mutex);
+                if (   !isRunning()
+                    || m_stopping.loadAcquire() != 0)
+                {
+                    return;
+                }
+                if (m_queue.tryPush(record))
+                {
+                    locker.unlock();
+                    wake();
+                    return;
+                }
+                m_wakeUp.wakeOne();
+                m_spaceAvailable.wait(&m_mutex);
+            }
+            break;
+        case OverflowPolicy::CountDrops:
+            m_dropped.ref();
+            return;
+        case OverflowPolicy::Drop:
+        default:
+            return;
+        }
+    }
+
+    wake();
+}
+
+void LogWriter::stop()
+{
+    if (isRunning())
+    {
+        m_stopping.storeRelease(1);
+        {
+            QMutexLocker locker(&m_mutex);
+            m_wakeUp.wakeOne();
+            m_spaceAvailable.wakeAll();
+        }
+        wait();
+    }
+    m_compressor.waitForDone();
+}
+
+void LogWriter::wake()
+{
+    // поток записи просыпается сам по истечении интервала, будить его нужно только при накоплении пакета.
+    if (m_queue.sizeApprox() >= static_cast<std::size_t>(::flushLines()))
+    {
+        m_wakeUp.wakeOne();
+    }
+}
+
+void LogWriter::rotate(QFile* file, QTextStream* output)
+{
+    output->flush();
+    output->setDevice(nullptr);
+    QString fileName = file->fileName();
+    file->close();
+
+    int keepCount = 0;
+    {
+        QMutexLocker locker(&m_mutex);
+        keepCount = m_keepCount;
+    }
+
+    QString segment = fileName + "." + QDateTime::currentDateTime().toString("yyyyMMdd-hhmmss-zzz");
+    if (QFile::rename(fileName, segment))
+    {
+        m_compressor.start(new ::CompressTask(segment, fileName, keepCount));
+    }
+    else
+    {
+        qWarning().noquote() << QString("Failed rotate log file %1").arg(fileName);
+    }
+
+    if (file->open(QFile::Append))
+    {
+        output->setDevice(file);
+    }
+    else
+    {
+        qWarning().noquote() << file->errorString();
+    }
+}
+
+void LogWriter::run()
+{
+    QFile file;
+    QTextStream output;
+    // размер сегмента считается в байтах UTF-8 (см. utf8Size), поэтому кодировка файла задаётся явно.
+    output.setCodec("UTF-8");
+    QString fileName;
+    int unflushed = 0;
+    QElapsedTimer sinceFlush;
+    sinceFlush.start();
+    qint64 written = 0;
+    QElapsedTimer segmentAge;
+    segmentAge.start();
+
+    LogRecord record;
+    for (;;)
+    {
+        const bool stopping = (m_stopping.loadAcquire() != 0);
+
+        QString requestedName;
+        qint64 maxSize = 0;
+        qint64 rotateIntervalMsec = 0;
+        {
+            QMutexLocker locker(&m_mutex);
+            requestedName = m_fileName;
+            maxSize = m_maxSize;
+            rotateIntervalMsec = m_rotateIntervalSec * 1000LL;
+        }
+        if (requestedName != fileName)
+        {
+            output.flush();
+            output.setDevice(nullptr);
+            file.close();
+            fileName = requestedName;
+            if (!fileName.isEmpty())
+            {
+                file.setFileName(fileName);
+                if (file.open(QFile::Append))
+                {
+                    output.setDevice(&file);
+                    written = file.size();
+                    segmentAge.restart();
+                }
+                else
+                {
+                    qWarning().noquote() << file.errorString();
+                }
+            }
+        }
+
+        int taken = 0;
+        while (   taken < ::flushLines()
+               && m_queue.tryPop(&record))
+        {
+            ++taken;
+            QString line = ::format(record);
+            ::printToConsole(record.type, line);
+            if (output.device() != nullptr)
+            {
+                output << line << '\n';
+                ++unflushed;
+                written += ::utf8Size(line) + 1;
+            }
+        }
+
+        if (taken > 0)
+        {
+            // место в очереди освободилось - продолжают производители, ожидающие его (OverflowPolicy::Block).
+            QMutexLocker locker(&m_mutex);
+            m_spaceAvailable.wakeAll();
+        }
+
+        int dropped = m_dropped.fetchAndStoreRelaxed(0);
+        if (dropped > 0)
+        {
+            record.type = QtWarningMsg;
+            record.timestamp = QDateTime::currentMSecsSinceEpoch();
+            record.text = QString("%1 log messages dropped: log queue is full").arg(dropped);
+            QString line = ::format(record);
+            ::printToConsole(record.type, line);
+            if (output.device() != nullptr)
+            {
+                output << line << '\n';
+                ++unflushed;
+                written += ::utf8Size(line) + 1;
+            }
+        }
+
+        if (   output.device() != nullptr
+            && written > 0
+            && (   (maxSize > 0 && written >= maxSize)
+                || (rotateIntervalMsec > 0 && segmentAge.elapsed() >= rotateIntervalMsec)))
+        {
+            rotate(&file, &output);
+            written = 0;
+            unflushed = 0;
+            segmentAge.restart();
+            sinceFlush.restart();
+        }
+
+        if (   unflushed > 0
+            && (   unflushed >= ::flushLines()
+                || sinceFlush.elapsed() >= ::flushIntervalMsec()
+                || stopping))
+        {
+            output.flush();
+            file.flush();
+            unflushed = 0;
+            sinceFlush.restart();
+        }
+
+        if (taken == 0)
+        {
+            if (stopping)
+            {
+                break;
+            }
+
+            QMutexLocker locker(&m_mutex);
+            if (m_stopping.loadAcquire() == 0)
+            {
+                m_wakeUp.wait(&m_mutex, ::flushIntervalMsec());
+            }
+        }
+    }
+
+    output.flush();
+    file.close();
+}
+
+} // Netcom
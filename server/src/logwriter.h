@@ -0,0 +1,208 @@
+#ifndef NETCOM_LOG_WRITER_H
+#define NETCOM_LOG_WRITER_H
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+#include <QAtomicInt>
+#include <QMutex>
+#include <QString>
+#include <QThread>
+#include <QThreadPool>
+#include <QWaitCondition>
+
+class QFile;
+class QTextStream;
+
+namespace Netcom
+{
+
+/**
+ * @struct LogRecord
+ * @brief  Сообщение журнала, ожидающее записи.
+ */
+struct LogRecord
+{
+    QtMsgType type = QtInfoMsg; //!< тип сообщения.
+    qint64 timestamp = 0;       //!< время сообщения (мс от начала эпохи).
+    QString text;               //!< текст сообщения.
+};
+
+/**
+ * @class LogQueue
+ * @brief Ограниченная очередь сообщений журнала без блокировок (несколько писателей, несколько читателей).
+ *
+ * @note  Каждая ячейка хранит номер последовательности, по которому писатель и читатель
+ *        определяют, свободна ли она, поэтому для занятия позиции достаточно одной атомарной операции.
+ */
+class LogQueue
+{
+public:
+    /**
+     * @param capacity - ёмкость очереди (округляется вверх до степени двойки).
+     */
+    explicit LogQueue(std::size_t capacity);
+    ~LogQueue();
+
+    /**
+     * @brief  tryPush - помещает сообщение в очередь.
+     * @param  record - сообщение (перемещается в очередь только при успехе).
+     * @return false - если очередь заполнена.
+     */
+    bool tryPush(LogRecord& record);
+
+    /**
+     * @brief  tryPop - извлекает сообщение из очереди.
+     * @param  record - извлечённое сообщение.
+     * @return false - если очередь пуста.
+     */
+    bool tryPop(LogRecord* record);
+
+    /**
+     * @brief  sizeApprox - возвращает приблизительное количество сообщений в очереди.
+     */
+    std::size_t sizeApprox() const;
+
+private:
+    Q_DISABLE_COPY(LogQueue)
+
+    struct Cell
+    {
+        std::atomic<std::size_t> sequence; //!< номер позиции, для которой ячейка готова.
+        LogRecord record;                  //!< сообщение.
+    };
+
+    /**
+     * @struct Position
+     * @brief  Позиция записи или чтения, занимающая отдельную строку кэша,
+     *         чтобы писатели и читатель не мешали друг другу.
+     */
+    struct Position
+    {
+        std::atomic<std::size_t> value;
+        char padding[64 - sizeof(std::atomic<std::size_t>)];
+    };
+
+    std::unique_ptr<Cell[]> m_cells; //!< ячейки очереди.
+    std::size_t m_mask;              //!< маска индекса ячейки (ёмкость - 1).
+    Position m_enqueuePos;           //!< следующая позиция записи.
+    Position m_dequeuePos;           //!< следующая позиция чтения.
+
+};
+
+/**
+ * @class LogWriter
+ * @brief Фоновая запись журнала: вызывающий поток только помещает сообщение в очередь,
+ *        а поток записи выводит сообщения в консоль и в постоянно открытый файл журнала пакетами.
+ *
+ * @note  Файл сбрасывается на диск после flushLines строк или через flushIntervalMsec.
+ *        При превышении размера или интервала ротации файл закрывается и переименовывается в сегмент
+ *        "<имя>.<время>", который сжимается в gzip "<имя>.<время>.gz" отдельным потоком.
+ */
+class LogWriter : public QThread
+{
+public:
+    /**
+     * @enum  OverflowPolicy
+     * @brief Поведение при заполненной очереди.
+     */
+    enum class OverflowPolicy
+    {
+        Block = 0,  //!< ожидать освобождения места в очереди.
+        Drop,       //!< отбросить сообщение.
+        CountDrops  //!< отбросить сообщение и сообщить в журнале количество отброшенных.
+    };
+
+    /**
+     * @param capacity - ёмкость очереди сообщений.
+     */
+    explicit LogWriter(std::size_t capacity = 8192);
+    ~LogWriter();
+
+    /**
+     * @brief setFileName - устанавливает имя файла журнала (из любого потока).
+     * @param fileName - имя файла журнала (пустое - журнал выводится только в консоль).
+     */
+    void setFileName(const QString& fileName);
+
+    /**
+     * @brief setOverflowPolicy - устанавливает поведение при заполненной очереди.
+     */
+    void setOverflowPolicy(OverflowPolicy policy);
+
+    /**
+     * @brief setRotation - устанавливает условия ротации файла журнала (из любого потока).
+     * @param maxSize - размер файла в байтах, при достижении которого начинается новый файл (0 - не ограничен).
+     * @param intervalSec - интервал в секундах, после которого начинается новый файл (0 - не ограничен).
+     * @param keepCount - количество хранимых сжатых сегментов, старые удаляются (0 - хранить все).
+     */
+    void setRotation(qint64 maxSize, int intervalSec, int keepCount);
+
+    /**
+     * @brief setLevel - устанавливает минимальный уровень выводимых сообщений.
+     * @param level - тип наименее важного выводимого сообщения (QtDebugMsg - выводить все).
+     */
+    void setLevel(QtMsgType level);
+
+    /**
+     * @brief  isEnabled - проверяет, будет ли выведено сообщение указанного типа.
+     * @param  type - тип сообщения.
+     * @return false - если уровень сообщения ниже установленного.
+     */
+    bool isEnabled(QtMsgType type) const;
+
+    /**
+     * @brief write - помещает сообщение в очередь записи (из любого потока).
+     * @param type - тип сообщения.
+     * @param text - текст сообщения.
+     *
+     * @note  Время сообщения запоминается при вызове, а форматируется потоком записи.
+     *        Сообщения ниже установленного уровня отбрасываются.
+     */
+    void write(QtMsgType type, const QString& text);
+
+    /**
+     * @brief stop - записывает оставшиеся в очереди сообщения и останавливает поток записи.
+     */
+    void stop();
+
+protected:
+    virtual void run() override;
+
+private:
+    /**
+     * @brief wake - будит поток записи, если в очереди набрался пакет.
+     */
+    void wake();
+
+    /**
+     * @brief rotate - закрывает файл журнала, передаёт его на сжатие и открывает новый файл с тем же именем.
+     * @param file - файл журнала.
+     * @param output - поток вывода в файл.
+     *
+     * @note  Вызывается потоком записи после вывода всех извлечённых сообщений,
+     *        поэтому строки не теряются и не переупорядочиваются.
+     */
+    void rotate(QFile* file, QTextStream* output);
+
+private:
+    LogQueue m_queue;                  //!< очередь сообщений.
+    QAtomicInt m_policy;               //!< поведение при заполненной очереди (OverflowPolicy).
+    QAtomicInt m_level;                //!< минимальная важность выводимых сообщений.
+    QAtomicInt m_dropped;              //!< количество отброшенных сообщений, ещё не указанное в журнале.
+    QAtomicInt m_stopping;             //!< признак остановки потока записи.
+    mutable QMutex m_mutex;            //!< блокировка имени файла, ожидания потока записи и ожидания места в очереди.
+    QWaitCondition m_wakeUp;           //!< пробуждение потока записи.
+    QWaitCondition m_spaceAvailable;   //!< освобождение места в очереди (для OverflowPolicy::Block).
+    QString m_fileName;                //!< имя файла журнала.
+    qint64 m_maxSize = 0;              //!< размер файла для ротации, байт.
+    int m_rotateIntervalSec = 0;       //!< интервал ротации, с.
+    int m_keepCount = 0;               //!< количество хранимых сжатых сегментов.
+    QThreadPool m_compressor;          //!< поток сжатия сегментов журнала.
+
+};
+
+} // Netcom
+
+#endif // NETCOM_LOG_WRITER_H
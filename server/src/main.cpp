@@ -3,6 +3,7 @@
 #include <QCommandLineParser>
 #include <QCoreApplication>
 #include <QDebug>
+#include <QHash>
 #include <QHostAddress>
 #include <QString>
 #include <QStringList>
@@ -10,6 +11,36 @@
 
 #include "server.h"
 
+namespace
+{
+
+/**
+ * @brief  parseSize - разбирает размер в байтах с необязательным суффиксом k, m или g.
+ * @param  text - строка размера.
+ * @param  ok - признак успешного разбора.
+ * @return размер в байтах.
+ */
+qint64 parseSize(const QString& text, bool* ok)
+{
+    static const QHash<QChar, qint64> multipliers({ { 'k', 1LL << 10 },
+                                                    { 'm', 1LL << 20 },
+                                                    { 'g', 1LL << 30 }
+                                                  });
+    QString value = text.trimmed().toLower();
+    qint64 multiplier = 1;
+    if (   !value.isEmpty()
+        && multipliers.contains(value.at(value.size() - 1)))
+    {
+        multiplier = multipliers.value(value.at(value.size() - 1));
+        value.chop(1);
+    }
+    qint64 result = value.toLongLong(ok) * multiplier;
+    *ok = (*ok && result >= 0);
+    return result;
+}
+
+}
+
 int main(int argc, char *argv[])
 {
     auto sighandler = [](int sigcode) { return qApp->exit(sigcode); };
@@ -29,6 +60,75 @@ int main(int argc, char *argv[])
                                   app.tr("filename"));
     parser.addOption(fileOption);
 
+    QCommandLineOption logOverflowOption(QStringList({ "log-overflow" }),
+                                         app.tr("Behaviour when the log queue is full: block, drop or count (drop and report the number of dropped messages)"),
+                                         app.tr("policy"),
+                                         "count");
+    parser.addOption(logOverflowOption);
+
+    QCommandLineOption logLevelOption(QStringList({ "l", "log-level" }),
+                                      app.tr("Minimal level of logged messages: debug (also dumps every incoming message), info, warning or critical"),
+                                      app.tr("level"),
+                                      "info");
+    parser.addOption(logLevelOption);
+
+    QCommandLineOption logMaxSizeOption(QStringList({ "log-max-size" }),
+                                        app.tr("Rotate the log file when it reaches the size in bytes, suffixes k, m and g are allowed (0 - no limit)"),
+                                        app.tr("size"),
+                                        "0");
+    parser.addOption(logMaxSizeOption);
+
+    QCommandLineOption logRotateIntervalOption(QStringList({ "log-rotate-interval" }),
+                                               app.tr("Rotate the log file every given number of seconds (0 - never)"),
+                                               app.tr("sec"),
+                                               "0");
+    parser.addOption(logRotateIntervalOption);
+
+    QCommandLineOption logKeepOption(QStringList({ "log-keep" }),
+                                     app.tr("Number of gzip-compressed rotated log files to keep (0 - keep all)"),
+                                     app.tr("count"),
+                                     "10");
+    parser.addOption(logKeepOption);
+
+    QCommandLineOption journalOption(QStringList({ "j", "journal" }),
+                                     app.tr("Binary journal of connect, disconnect, subscribe, unsubscribe and request events (see netcom-journal)"),
+                                     app.tr("filename"));
+    parser.addOption(journalOption);
+
+    QCommandLineOption pushIntervalOption(QStringList({ "p", "push-interval" }),
+                                          app.tr("Interval for coalescing roster updates pushed to subscribers, msec (negative - disable pushes)"),
+                                          app.tr("msec"),
+                                          "100");
+    parser.addOption(pushIntervalOption);
+
+    QCommandLineOption threadsOption(QStringList({ "t", "threads" }),
+                                     app.tr("Number of worker threads serving TCP connections (0 - serve in the main thread)"),
+                                     app.tr("count"),
+                                     "0");
+    parser.addOption(threadsOption);
+
+    QCommandLineOption reusePortOption(QStringList({ "r", "reuse-port" }),
+                                       app.tr("Open a socket per worker thread with SO_REUSEPORT and let the kernel spread connections and datagrams"));
+    parser.addOption(reusePortOption);
+
+    QCommandLineOption batchedOption(QStringList({ "b", "batched-udp" }),
+                                     app.tr("Receive and send UDP datagrams in batches with recvmmsg/sendmmsg (Linux only)"));
+    parser.addOption(batchedOption);
+
+    QCommandLineOption noDelayOption(QStringList({ "n", "tcp-nodelay" }),
+                                     app.tr("Set TCP_NODELAY on client connections so short replies are not delayed"));
+    parser.addOption(noDelayOption);
+
+    QCommandLineOption corkOption(QStringList({ "tcp-cork" }),
+                                  app.tr("Set TCP_CORK while a multi-frame response (chunked roster) is sent so its frames go out in full segments (Linux only)"));
+    parser.addOption(corkOption);
+
+    QCommandLineOption compressOption(QStringList({ "z", "compress" }),
+                                      app.tr("Compress frames whose body is at least the given size in bytes for clients that accept compression, suffixes k, m and g are allowed (0 - never)"),
+                                      app.tr("size"),
+                                      "0");
+    parser.addOption(compressOption);
+
     parser.process(app);
 
     if (parser.isSet("help"))
@@ -42,6 +142,76 @@ int main(int argc, char *argv[])
         logFileName = parser.value(fileOption);
     }
 
+    static const QHash<QString, Netcom::LogWriter::OverflowPolicy> overflowPolicies({ { "block", Netcom::LogWriter::OverflowPolicy::Block },
+                                                                                      { "drop",  Netcom::LogWriter::OverflowPolicy::Drop },
+                                                                                      { "count", Netcom::LogWriter::OverflowPolicy::CountDrops }
+                                                                                    });
+    QString overflowPolicy = parser.value(logOverflowOption).toLower();
+    if (!overflowPolicies.contains(overflowPolicy))
+    {
+        qCritical().noquote() << app.tr("Invalid log overflow policy: %1.").arg(parser.value(logOverflowOption));
+        parser.showHelp(EXIT_FAILURE);
+    }
+
+    static const QHash<QString, QtMsgType> logLevels({ { "debug",    QtDebugMsg },
+                                                       { "info",     QtInfoMsg },
+                                                       { "warning",  QtWarningMsg },
+                                                       { "critical", QtCriticalMsg }
+                                                     });
+    QString logLevel = parser.value(logLevelOption).toLower();
+    if (!logLevels.contains(logLevel))
+    {
+        qCritical().noquote() << app.tr("Invalid log level: %1.").arg(parser.value(logLevelOption));
+        parser.showHelp(EXIT_FAILURE);
+    }
+
+    bool ok = false;
+    qint64 logMaxSize = ::parseSize(parser.value(logMaxSizeOption), &ok);
+    if (!ok)
+    {
+        qCritical().noquote() << app.tr("Invalid log max size: %1.").arg(parser.value(logMaxSizeOption));
+        parser.showHelp(EXIT_FAILURE);
+    }
+
+    int logRotateInterval = parser.value(logRotateIntervalOption).toInt(&ok);
+    if (   !ok
+        || logRotateInterval < 0)
+    {
+        qCritical().noquote() << app.tr("Invalid log rotate interval: %1.").arg(parser.value(logRotateIntervalOption));
+        parser.showHelp(EXIT_FAILURE);
+    }
+
+    int logKeep = parser.value(logKeepOption).toInt(&ok);
+    if (   !ok
+        || logKeep < 0)
+    {
+        qCritical().noquote() << app.tr("Invalid log keep count: %1.").arg(parser.value(logKeepOption));
+        parser.showHelp(EXIT_FAILURE);
+    }
+
+    int pushInterval = parser.value(pushIntervalOption).toInt(&ok);
+    if (!ok)
+    {
+        qCritical().noquote() << app.tr("Invalid push interval: %1.").arg(parser.value(pushIntervalOption));
+        parser.showHelp(EXIT_FAILURE);
+    }
+
+    int threadsCount = parser.value(threadsOption).toInt(&ok);
+    if (   !ok
+        || threadsCount < 0)
+    {
+        qCritical().noquote() << app.tr("Invalid threads count: %1.").arg(parser.value(threadsOption));
+        parser.showHelp(EXIT_FAILURE);
+    }
+
+    qint64 compressThreshold = ::parseSize(parser.value(compressOption), &ok);
+    if (   !ok
+        || compressThreshold > Netcom::Message::maxFrameSize)
+    {
+        qCritical().noquote() << app.tr("Invalid compression threshold: %1.").arg(parser.value(compressOption));
+        parser.showHelp(EXIT_FAILURE);
+    }
+
     QStringList args = parser.positionalArguments();
     if (args.isEmpty())
     {
@@ -69,6 +239,17 @@ int main(int argc, char *argv[])
     if (server != nullptr)
     {
         server->setLogFileName(logFileName);
+        server->setLogOverflowPolicy(overflowPolicies.value(overflowPolicy));
+        server->setLogLevel(logLevels.value(logLevel));
+        server->setLogRotation(logMaxSize, logRotateInterval, logKeep);
+        server->setJournalFileName(parser.value(journalOption));
+        server->setPushInterval(pushInterval);
+        server->setThreadsCount(threadsCount);
+        server->setReusePort(parser.isSet(reusePortOption));
+        server->setBatchedDatagrams(parser.isSet(batchedOption));
+        server->setTcpNoDelay(parser.isSet(noDelayOption));
+        server->setTcpCork(parser.isSet(corkOption));
+        server->setCompressionThreshold(static_cast<int>(compressThreshold));
         if (server->start())
         {
             return app.exec();
@@ -0,0 +1,365 @@
+#include "nativesocket.h"
+
+#include <vector>
+
+#include <QByteArray>
+#include <QCoreApplication>
+#include <QHostAddress>
+#include <QList>
+#include <QString>
+
+#ifdef Q_OS_UNIX
+#include <cerrno>
+#include <cstring>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+
+#ifdef Q_OS_UNIX
+socklen_t toNative(const QHostAddress& address, quint16 port, sockaddr_storage* storage)
+{
+    ::memset(storage, 0, sizeof(sockaddr_storage));
+    if (address.protocol() == QAbstractSocket::IPv6Protocol)
+    {
+        sockaddr_in6* ipv6 = reinterpret_cast<sockaddr_in6*>(storage);
+        Q_IPV6ADDR raw = address.toIPv6Address();
+        ipv6->sin6_family = AF_INET6;
+        ipv6->sin6_port = htons(port);
+        ::memcpy(&ipv6->sin6_addr, raw.c, sizeof(raw.c));
+        return sizeof(sockaddr_in6);
+    }
+
+    sockaddr_in* ipv4 = reinterpret_cast<sockaddr_in*>(storage);
+    ipv4->sin_family = AF_INET;
+    ipv4->sin_port = htons(port);
+    ipv4->sin_addr.s_addr = htonl(address.toIPv4Address());
+    return sizeof(sockaddr_in);
+}
+#endif
+
+#ifdef Q_OS_LINUX
+void fromNative(const sockaddr_storage& storage, QHostAddress* address, quint16* port)
+{
+    if (storage.ss_family == AF_INET6)
+    {
+        const sockaddr_in6* ipv6 = reinterpret_cast<const sockaddr_in6*>(&storage);
+        address->setAddress(reinterpret_cast<const quint8*>(&ipv6->sin6_addr));
+        *port = ntohs(ipv6->sin6_port);
+    }
+    else
+    {
+        const sockaddr_in* ipv4 = reinterpret_cast<const sockaddr_in*>(&storage);
+        address->setAddress(ntohl(ipv4->sin_addr.s_addr));
+        *port = ntohs(ipv4->sin_port);
+    }
+}
+#endif
+
+}
+
+namespace Netcom
+{
+namespace NativeSocket
+{
+
+qintptr openBound(QAbstractSocket::SocketType type, const QHostAddress& address, quint16 port, bool reusePort, QString* error)
+{
+    Q_CHECK_PTR(error);
+
+#ifdef Q_OS_UNIX
+#ifndef SO_REUSEPORT
+    if (reusePort)
+    {
+        *error = qApp->tr("SO_REUSEPORT is not supported on this platform");
+        return -1;
+    }
+#endif
+
+    sockaddr_storage storage;
+    socklen_t length = ::toNative(address, port, &storage);
+
+    const bool isTcp = (type == QAbstractSocket::TcpSocket);
+    const int enabled = 1;
+    int descriptor = ::socket(storage.ss_family, isTcp ? SOCK_STREAM : SOCK_DGRAM, 0);
+    bool ok = (   descriptor >= 0
+               && (!isTcp || ::setsockopt(descriptor, SOL_SOCKET, SO_REUSEADDR, &enabled, sizeof(enabled)) == 0));
+#ifdef SO_REUSEPORT
+    ok = ok && (!reusePort || ::setsockopt(descriptor, SOL_SOCKET, SO_REUSEPORT, &enabled, sizeof(enabled)) == 0);
+#endif
+    ok = ok && ::bind(descriptor, reinterpret_cast<sockaddr*>(&storage), length) == 0
+            && (!isTcp || ::listen(descriptor, SOMAXCONN) == 0);
+    if (!ok)
+    {
+        *error = QString::fromLocal8Bit(::strerror(errno));
+        if (descriptor >= 0)
+        {
+            ::close(descriptor);
+        }
+        return -1;
+    }
+    return descriptor;
+#else
+    Q_UNUSED(type);
+    Q_UNUSED(address);
+    Q_UNUSED(port);
+    Q_UNUSED(reusePort);
+    *error = qApp->tr("Native sockets are not supported on this platform");
+    return -1;
+#endif
+}
+
+void close(qintptr descriptor)
+{
+#ifdef Q_OS_UNIX
+    if (descriptor >= 0)
+    {
+        ::close(static_cast<int>(descriptor));
+    }
+#else
+    Q_UNUSED(descriptor);
+#endif
+}
+
+qint64 send(qintptr descriptor, const QByteArray* parts, int count)
+{
+#ifdef Q_OS_UNIX
+    std::vector<iovec> vectors(static_cast<std::size_t>(count));
+    for (int i = 0; i < count; ++i)
+    {
+        vectors[i].iov_base = const_cast<char*>(parts[i].constData());
+        vectors[i].iov_len = static_cast<std::size_t>(parts[i].size());
+    }
+
+    msghdr header;
+    ::memset(&header, 0, sizeof(header));
+    header.msg_iov = vectors.data();
+    header.msg_iovlen = vectors.size();
+
+    int flags = MSG_DONTWAIT;
+#ifdef MSG_NOSIGNAL
+    flags |= MSG_NOSIGNAL;
+#endif
+    ssize_t sent = 0;
+    do
+    {
+        sent = ::sendmsg(static_cast<int>(descriptor), &header, flags);
+    }
+    while (sent < 0 && errno == EINTR);
+
+    if (sent < 0)
+    {
+        return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0
+                                                         : -1;
+    }
+    return sent;
+#else
+    Q_UNUSED(descriptor);
+    Q_UNUSED(parts);
+    Q_UNUSED(count);
+    return -1;
+#endif
+}
+
+bool setCork(qintptr descriptor, bool enabled)
+{
+#if defined(Q_OS_LINUX) && defined(TCP_CORK)
+    const int value = (enabled ? 1 : 0);
+    return (::setsockopt(static_cast<int>(descriptor), IPPROTO_TCP, TCP_CORK, &value, sizeof(value)) == 0);
+#else
+    Q_UNUSED(descriptor);
+    Q_UNUSED(enabled);
+    return false;
+#endif
+}
+
+struct DatagramBatch::Private
+{
+    int capacity = 0;            //!< количество датаграмм в пакете.
+    int datagramSize = 0;        //!< размер буфера приёма одной датаграммы.
+    QByteArray buffer;           //!< буферы приёма всех датаграмм пакета.
+    QList<QByteArray> outgoing;  //!< датаграммы для отправки.
+#ifdef Q_OS_LINUX
+    std::vector<mmsghdr> received;             //!< заголовки recvmmsg.
+    std::vector<iovec> receivedVectors;        //!< буферы recvmmsg.
+    std::vector<sockaddr_storage> receivedFrom; //!< отправители принятых датаграмм.
+    std::vector<mmsghdr> sent;                  //!< заголовки sendmmsg.
+    std::vector<iovec> sentVectors;             //!< данные sendmmsg.
+    std::vector<sockaddr_storage> sendTo;       //!< получатели датаграмм для отправки.
+    std::vector<socklen_t> sendToLength;        //!< размеры адресов получателей.
+#endif
+    int receivedCount = 0;       //!< количество принятых датаграмм.
+};
+
+DatagramBatch::DatagramBatch(int capacity, int datagramSize) :
+    d(new Private())
+{
+    d->capacity = qMax(1, capacity);
+    d->datagramSize = qMax(1, datagramSize);
+#ifdef Q_OS_LINUX
+    d->buffer.resize(d->capacity * d->datagramSize);
+    d->received.resize(d->capacity);
+    d->receivedVectors.resize(d->capacity);
+    d->receivedFrom.resize(d->capacity);
+    d->sent.resize(d->capacity);
+    d->sentVectors.resize(d->capacity);
+    d->sendTo.reserve(d->capacity);
+    d->sendToLength.reserve(d->capacity);
+#endif
+    d->outgoing.reserve(d->capacity);
+}
+
+DatagramBatch::~DatagramBatch()
+{
+
+}
+
+bool DatagramBatch::isSupported()
+{
+#ifdef Q_OS_LINUX
+    return true;
+#else
+    return false;
+#endif
+}
+
+int DatagramBatch::capacity() const
+{
+    return d->capacity;
+}
+
+int DatagramBatch::receive(qintptr descriptor)
+{
+    d->receivedCount = 0;
+#ifdef Q_OS_LINUX
+    for (int i = 0; i < d->capacity; ++i)
+    {
+        d->receivedVectors[i].iov_base = d->buffer.data() + i * d->datagramSize;
+        d->receivedVectors[i].iov_len = d->datagramSize;
+        msghdr& header = d->received[i].msg_hdr;
+        ::memset(&header, 0, sizeof(header));
+        header.msg_name = &d->receivedFrom[i];
+        header.msg_namelen = sizeof(sockaddr_storage);
+        header.msg_iov = &d->receivedVectors[i];
+        header.msg_iovlen = 1;
+        d->received[i].msg_len = 0;
+    }
+
+    int count = ::recvmmsg(static_cast<int>(descriptor), d->received.data(), d->capacity, MSG_DONTWAIT, nullptr);
+    if (count < 0)
+    {
+        return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0
+                                                         : -1;
+    }
+    d->receivedCount = count;
+    return count;
+#else
+    Q_UNUSED(descriptor);
+    return -1;
+#endif
+}
+
+const char* DatagramBatch::data(int index) const
+{
+    Q_ASSERT(index >= 0 && index < d->receivedCount);
+    return d->buffer.constData() + index * d->datagramSize;
+}
+
+int DatagramBatch::size(int index) const
+{
+    Q_ASSERT(index >= 0 && index < d->receivedCount);
+#ifdef Q_OS_LINUX
+    return static_cast<int>(d->received[index].msg_len);
+#else
+    return 0;
+#endif
+}
+
+void DatagramBatch::peer(int index, QHostAddress* address, quint16* port) const
+{
+    Q_ASSERT(index >= 0 && index < d->receivedCount);
+    Q_CHECK_PTR(address);
+    Q_CHECK_PTR(port);
+#ifdef Q_OS_LINUX
+    ::fromNative(d->receivedFrom[index], address, port);
+#else
+    address->clear();
+    *port = 0;
+#endif
+}
+
+bool DatagramBatch::append(const QHostAddress& address, quint16 port, const QByteArray& datagram)
+{
+    if (d->outgoing.size() >= d->capacity)
+    {
+        return false;
+    }
+
+#ifdef Q_OS_LINUX
+    sockaddr_storage storage;
+    d->sendToLength.push_back(::toNative(address, port, &storage));
+    d->sendTo.push_back(storage);
+#else
+    Q_UNUSED(address);
+    Q_UNUSED(port);
+#endif
+    d->outgoing.append(datagram);
+    return true;
+}
+
+bool DatagramBatch::isEmpty() const
+{
+    return d->outgoing.isEmpty();
+}
+
+int DatagramBatch::flush(qintptr descriptor)
+{
+    int result = 0;
+#ifdef Q_OS_LINUX
+    const int count = d->outgoing.size();
+    for (int i = 0; i < count; ++i)
+    {
+        d->sentVectors[i].iov_base = const_cast<char*>(d->outgoing.at(i).constData());
+        d->sentVectors[i].iov_len = d->outgoing.at(i).size();
+        msghdr& header = d->sent[i].msg_hdr;
+        ::memset(&header, 0, sizeof(header));
+        header.msg_name = &d->sendTo[i];
+        header.msg_namelen = d->sendToLength[i];
+        header.msg_iov = &d->sentVectors[i];
+        header.msg_iovlen = 1;
+        d->sent[i].msg_len = 0;
+    }
+
+    while (result < count)
+    {
+        int sent = ::sendmmsg(static_cast<int>(descriptor), d->sent.data() + result, count - result, MSG_DONTWAIT);
+        if (sent <= 0)
+        {
+            if (result == 0)
+            {
+                result = -1;
+            }
+            break;
+        }
+        result += sent;
+    }
+
+    d->sendTo.clear();
+    d->sendToLength.clear();
+#else
+    Q_UNUSED(descriptor);
+    result = -1;
+#endif
+    d->outgoing.clear();
+    return result;
+}
+
+} // NativeSocket
+} // Netcom
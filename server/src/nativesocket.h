@@ -0,0 +1,133 @@
+#ifndef NETCOM_NATIVE_SOCKET_H
+#define NETCOM_NATIVE_SOCKET_H
+
+#include <memory>
+
+#include <QAbstractSocket>
+
+class QByteArray;
+class QHostAddress;
+class QString;
+
+namespace Netcom
+{
+
+/**
+ * @namespace NativeSocket
+ * @brief     Операции с сокетами, недоступные через классы Qt.
+ */
+namespace NativeSocket
+{
+
+/**
+ * @brief  openBound - открывает сокет, привязанный к address:port
+ *                     (TCP-сокет переводится в режим приёма подключений).
+ * @param  type - тип сокета (TCP/UDP).
+ * @param  address - адрес привязки.
+ * @param  port - порт привязки.
+ * @param  reusePort - установить опцию SO_REUSEPORT.
+ * @param  error - текст сообщения об ошибке.
+ * @return дескриптор сокета, -1 - в случае ошибки.
+ *
+ * @note   С опцией SO_REUSEPORT ядро распределяет входящие подключения и датаграммы
+ *         между всеми сокетами, открытыми так на одном порту.
+ */
+qintptr openBound(QAbstractSocket::SocketType type, const QHostAddress& address, quint16 port, bool reusePort, QString* error);
+
+/**
+ * @brief close - закрывает дескриптор, не переданный объекту Qt.
+ * @param descriptor - дескриптор сокета.
+ */
+void close(qintptr descriptor);
+
+/**
+ * @brief  send - отправляет содержимое нескольких буферов одним системным вызовом (sendmsg), не ожидая готовности сокета.
+ * @param  descriptor - дескриптор подключённого TCP-сокета.
+ * @param  parts - буферы (данные не копируются).
+ * @param  count - количество буферов.
+ * @return количество отправленных байт (0 - буфер отправки сокета заполнен, -1 - ошибка или платформа не поддерживается).
+ */
+qint64 send(qintptr descriptor, const QByteArray* parts, int count);
+
+/**
+ * @brief  setCork - устанавливает опцию TCP_CORK: пока она установлена, неполные сегменты не отправляются.
+ * @param  descriptor - дескриптор TCP-сокета.
+ * @param  enabled - значение опции (при снятии накопленные данные отправляются сразу).
+ * @return false - если опция не установлена (доступна только в Linux).
+ */
+bool setCork(qintptr descriptor, bool enabled);
+
+/**
+ * @class DatagramBatch
+ * @brief Пакетный приём и отправка UDP-датаграмм: до capacity датаграмм за один системный вызов (recvmmsg/sendmmsg).
+ *
+ * @note  Буферы приёма выделяются один раз при создании. Доступно только в Linux (см. isSupported).
+ */
+class DatagramBatch
+{
+public:
+    /**
+     * @param capacity - количество датаграмм в пакете.
+     * @param datagramSize - размер буфера приёма одной датаграммы.
+     */
+    explicit DatagramBatch(int capacity = 32, int datagramSize = 65536);
+    ~DatagramBatch();
+
+    /**
+     * @brief  isSupported - проверяет, доступен ли пакетный обмен датаграммами на этой платформе.
+     */
+    static bool isSupported();
+
+    /**
+     * @brief  capacity - возвращает количество датаграмм в пакете.
+     */
+    int capacity() const;
+
+    /**
+     * @brief  receive - принимает готовые датаграммы, не ожидая новых.
+     * @param  descriptor - дескриптор UDP-сокета.
+     * @return количество принятых датаграмм (0 - нет готовых датаграмм, -1 - ошибка).
+     *
+     * @note   Принятые датаграммы доступны через data/size/peer до следующего вызова receive.
+     */
+    int receive(qintptr descriptor);
+
+    const char* data(int index) const;
+    int size(int index) const;
+    void peer(int index, QHostAddress* address, quint16* port) const;
+
+    /**
+     * @brief  append - добавляет датаграмму в пакет для отправки.
+     * @param  address - адрес получателя.
+     * @param  port - порт получателя.
+     * @param  datagram - датаграмма (данные не копируются).
+     * @return false - если пакет уже заполнен.
+     */
+    bool append(const QHostAddress& address, quint16 port, const QByteArray& datagram);
+
+    /**
+     * @brief  isEmpty - проверяет, есть ли датаграммы для отправки.
+     */
+    bool isEmpty() const;
+
+    /**
+     * @brief  flush - отправляет накопленные датаграммы и очищает пакет.
+     * @param  descriptor - дескриптор UDP-сокета.
+     * @return количество отправленных датаграмм (-1 - ошибка до отправки первой датаграммы).
+     *
+     * @note   Датаграммы, не принятые ядром (переполнен буфер отправки), отбрасываются.
+     */
+    int flush(qintptr descriptor);
+
+private:
+    Q_DISABLE_COPY(DatagramBatch)
+
+    struct Private;
+    std::unique_ptr<Private> d; //!< буферы и заголовки системных вызовов.
+
+};
+
+} // NativeSocket
+} // Netcom
+
+#endif // NETCOM_NATIVE_SOCKET_H
@@ -1,16 +1,55 @@
 #include "server.h"
 
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <iterator>
+
 #include <QCoreApplication>
-#include <QDataStream>
-#include <QDebug>
-#include <QFile>
-#include <QTextStream>
-#include <QTcpServer>
+#include <QMutexLocker>
+#include <QReadLocker>
+#include <QSocketNotifier>
 #include <QTcpSocket>
+#include <QThread>
+#include <QTimer>
+#include <QWriteLocker>
 #include <QUdpSocket>
+#include <QVariant>
 
 #include <protocol.h>
 
+#include "nativesocket.h"
+
+namespace
+{
+
+int historyDepth() { return 1024; }
+
+int defaultPushIntervalMsec() { return 100; }
+
+int maxBatchesPerRead() { return 16; }
+
+const char* connectionIdProperty() { return "netcomConnectionId"; }
+
+// XML-кадр из такого количества клиентов (около 30 КБ) помещается в одну UDP-датаграмму.
+int clientsPerChunk() { return 256; }
+
+std::array<quint8, 16> rawAddress(const Netcom::ClientInfo& info)
+{
+    std::array<quint8, 16> result;
+    std::copy(std::begin(info.address), std::end(info.address), result.begin());
+    return result;
+}
+
+QByteArray frame(const Netcom::Message& message)
+{
+    QByteArray serialized;
+    message.serializeInto(serialized);
+    return serialized;
+}
+
+}
+
 namespace Netcom
 {
 
@@ -76,481 +115,1531 @@ std::unique_ptr<Server> Server::createServer(QAbstractSocket::SocketType protoco
 }
 
 Server::Server(const NetworkAddress& address) :
-    m_address(address)
+    m_address(address),
+    // отсчёт поколений начинается с текущего времени, чтобы после перезапуска сервера
+    // поколение, сохранённое клиентом, не совпало с новым.
+    m_generation(static_cast<quint64>(QDateTime::currentMSecsSinceEpoch())),
+    m_pushTimer(new QTimer()),
+    m_logWriter(new LogWriter())
 {
+    m_logWriter->start();
 
+    m_pushTimer->setSingleShot(true);
+    m_pushTimer->setInterval(::defaultPushIntervalMsec());
+    QObject::connect(m_pushTimer.get(), &QTimer::timeout,
+                     [this]() { pushRoster(); });
 }
 
 Server::~Server()
 {
-    QHash<QAbstractSocket*, QDateTime>::iterator it = m_activeConnections.begin();
-    while (it != m_activeConnections.end())
-    {
-        QAbstractSocket* each = it.key();
-        each->close();
-        each->deleteLater();
-        it = m_activeConnections.erase(it);
-    }
+    // подключения закрываются обработчиками при остановке сервера (см. stopWorkers).
 }
 
 bool Server::start()
 {
-    return run();
+    if (!m_journalFileName.isEmpty())
+    {
+        QString error;
+        if (!m_journal.open(m_journalFileName, &error))
+        {
+            setLastError(error);
+            return false;
+        }
+    }
+
+    if (!run())
+    {
+        m_journal.close();
+        return false;
+    }
+    return true;
 }
 
 void Server::stop()
 {
+    m_pushTimer->stop();
     finish();
+    // события отключения клиентов при остановке обработчиков уже записаны.
+    m_journal.close();
 }
 
-void Server::addConnection(QAbstractSocket* socket)
+ConnectionId Server::addConnection(ServerWorker* worker, const NetworkAddress& peer)
 {
-    Q_CHECK_PTR(socket);
-
-    if (!m_activeConnections.contains(socket))
+    Q_CHECK_PTR(worker);
+
+    Connection connection;
+    connection.info = ClientInfo(peer.address,
+                                 peer.port,
+                                 QDateTime::currentMSecsSinceEpoch());
+    connection.worker = worker;
+    ConnectionId id = 0;
     {
-        m_activeConnections.insert(socket, QDateTime::currentDateTime());
-        logging(qApp->tr("%1 - Added connection from %2:%3")
-                .arg(m_activeConnections[socket].toString("hh:mm:ss.zzz"))
-                .arg(socket->peerAddress().toString())
-                .arg(socket->peerPort()),
-                QtInfoMsg);
+        QWriteLocker locker(&m_registryLock);
+        id = m_activeConnections.insert(connection.info.connected, connection);
+        m_addressIndex.emplace(::rawAddress(connection.info), id);
+        registerChange(true, connection.info);
     }
+    journal(JournalRecord::Event::Connect, id, connection);
+    logging(QtInfoMsg, [&connection]()
+    {
+        return qApp->tr("Added connection from %1:%2")
+               .arg(connection.info.addressString())
+               .arg(connection.info.port);
+    });
+    return id;
 }
 
-void Server::removeConnection(QAbstractSocket* socket)
+void Server::removeConnection(ConnectionId id)
 {
-    Q_CHECK_PTR(socket);
-
-    if (m_activeConnections.contains(socket))
+    Connection connection;
     {
-        m_activeConnections.remove(socket);
-        logging(qApp->tr("%1 - Removed connection from %2:%3")
-                .arg(QDateTime::currentDateTime().toString("hh:mm:ss.zzz"))
-                .arg(socket->peerAddress().toString())
-                .arg(socket->peerPort()),
-                QtInfoMsg);
+        QWriteLocker locker(&m_registryLock);
+        // адрес берётся из записи о подключении: у отключившегося сокета он уже сброшен.
+        if (!m_activeConnections.take(id, &connection))
+        {
+            return;
+        }
+        auto range = m_addressIndex.equal_range(::rawAddress(connection.info));
+        for (auto it = range.first; it != range.second; ++it)
+        {
+            if (it->second == id)
+            {
+                m_addressIndex.erase(it);
+                break;
+            }
+        }
+        registerChange(false, connection.info);
     }
+    journal(JournalRecord::Event::Disconnect, id, connection);
+    logging(QtInfoMsg, [&connection]()
+    {
+        return qApp->tr("Removed connection from %1:%2")
+               .arg(connection.info.addressString())
+               .arg(connection.info.port);
+    });
 }
 
 QString Server::errorString() const
 {
+    QMutexLocker locker(&m_mutex);
     return m_lastError;
 }
 
+void Server::setLastError(const QString& error)
+{
+    QMutexLocker locker(&m_mutex);
+    m_lastError = error;
+}
+
 void Server::setLogFileName(const QString& fileName)
 {
-    m_logFileName = fileName;
+    m_logWriter->setFileName(fileName);
 }
 
-void Server::incomingMessage(const Message& message, QAbstractSocket* sender)
+void Server::setLogOverflowPolicy(LogWriter::OverflowPolicy policy)
 {
-    Q_CHECK_PTR(sender);
+    m_logWriter->setOverflowPolicy(policy);
+}
 
-    logging(qApp->tr("%1 - Incoming message from %2:%3]:\n%4")
-            .arg(QDateTime::currentDateTime().toString("hh:mm:ss.zzz"))
-            .arg(sender->peerAddress().toString())
-            .arg(sender->peerPort())
-            .arg(QString::fromUtf8(message.serialize())),
-            QtInfoMsg);
-    switch (message.type())
-    {
-    case Message::Type::InfoRequest:
-        {
-            Message response(Message::Type::InfoResponse);
-            QHashIterator<QAbstractSocket*, QDateTime> it(m_activeConnections);
-            while (it.hasNext())
-            {
-                QAbstractSocket* eachClient = it.peekNext().key();
-                const QDateTime& eachDateTime = it.peekNext().value();
-                response.addClientInfo(ClientInfo(eachClient->peerAddress().toString(),
-                                                  eachClient->peerPort(),
-                                                  eachDateTime));
-                it.next();
-            }
+void Server::setLogLevel(QtMsgType level)
+{
+    m_logWriter->setLevel(level);
+}
 
-            QByteArray serialized;
-            {
-                QDataStream output(&serialized, QIODevice::WriteOnly);
-                output << response;
-            }
+void Server::setLogRotation(qint64 maxSize, int intervalSec, int keepCount)
+{
+    m_logWriter->setRotation(maxSize, intervalSec, keepCount);
+}
 
-            auto founded = m_activeConnections.find(sender);
-            if (founded != m_activeConnections.end())
-            {
-                founded.key()->write(serialized);
-            }
-        }
-    default:
-        break;
-    }
+void Server::setJournalFileName(const QString& fileName)
+{
+    m_journalFileName = fileName;
 }
 
-void Server::logging(const QString& message, QtMsgType type) const
+void Server::setPushInterval(int msec)
 {
-    switch (type)
+    m_pushEnabled = (msec >= 0);
+    if (m_pushEnabled)
     {
-    case QtDebugMsg:
-        qDebug().noquote() << message;
-        break;
-    case QtInfoMsg:
-        qInfo().noquote() << message;
-        break;
-    case QtWarningMsg:
-        qWarning().noquote() << message;
-        break;
-    case QtCriticalMsg:
-    default:
-        qCritical().noquote() << message;
-        break;
+        m_pushTimer->setInterval(msec);
     }
-
-    if (!m_logFileName.isEmpty())
+    else
     {
-        QFile f(m_logFileName);
-        if (f.open(QFile::Append))
-        {
-            QTextStream output(&f);
-            output << message << endl;
-        }
-        else
-        {
-            qWarning().noquote() << f.errorString();
-        }
+        m_pushTimer->stop();
+        m_pushScheduled.storeRelease(0);
     }
 }
 
-TcpServer::TcpServer(const NetworkAddress& address, QObject* parent) :
-    QObject(parent),
-    Server(address),
-    m_srv(new QTcpServer(this))
+void Server::setThreadsCount(int count)
 {
-    connect(m_srv, &QTcpServer::newConnection,
-            this, &TcpServer::slotOnNewConnect);
+    m_threadsCount = qMax(0, count);
 }
 
-TcpServer::~TcpServer()
+void Server::setReusePort(bool enabled)
 {
-    stop();
+    m_reusePort = enabled;
 }
 
-bool TcpServer::run()
+void Server::setBatchedDatagrams(bool enabled)
 {
-    QHostAddress listeningAddress = (m_address.address == QHostAddress::LocalHost ? m_address.address
-                                                                                  : (m_address.address.protocol() == QTcpSocket::IPv6Protocol ? QHostAddress::AnyIPv6
-                                                                                                                                              : QHostAddress::AnyIPv4));
-    bool ok = m_srv->listen(listeningAddress, m_address.port);
-    m_lastError = ok ? QString::null
-                     : m_srv->errorString();
-    return ok;
+    m_batchedDatagrams = enabled;
 }
 
-void TcpServer::finish()
+void Server::setTcpNoDelay(bool enabled)
 {
-    m_srv->close();
+    m_tcpNoDelay = enabled;
+}
+
+void Server::setTcpCork(bool enabled)
+{
+    m_tcpCork = enabled;
+}
+
+void Server::setCompressionThreshold(int bytes)
+{
+    m_compressionThreshold = qMax(0, bytes);
+}
+
+void Server::sendFrame(ServerWorker* worker, ConnectionId id, const QByteArray& frame)
+{
+    Q_CHECK_PTR(worker);
 
-    QHash<QTcpSocket*, QByteArray>::iterator it = m_clients.begin();
-    while (it != m_clients.end())
+    // сокетами может пользоваться только поток их обработчика, из других потоков кадр передаётся через очередь событий.
+    if (worker->thread() != QThread::currentThread())
     {
-        QTcpSocket* each = it.key();
-        it = m_clients.erase(it);
-        each->disconnectFromHost();
+        worker->queueFrame(id, frame);
+    }
+    else
+    {
+        worker->writeFrame(id, frame);
     }
 }
 
-void TcpServer::slotOnNewConnect()
+void Server::sendFrames(ServerWorker* worker, ConnectionId id, const QList<QByteArray>& frames)
 {
-    QTcpSocket* socket = m_srv->nextPendingConnection();
-    connect(socket, static_cast<void(QTcpSocket::*)(QAbstractSocket::SocketError)>(&QTcpSocket::error),
-            this, &TcpServer::slotOnError);
-    connect(socket, &QTcpSocket::disconnected,
-            this, &TcpServer::slotOnDisconnect);
+    Q_CHECK_PTR(worker);
 
-    if (   m_address.address != QHostAddress::LocalHost
-        && m_address.address != QHostAddress::Any)
+    if (worker->thread() != QThread::currentThread())
     {
-        if (socket->peerAddress() != m_address.address)
-        {
-            logging(tr("%1 - Discard connection from %2. Expected only %3.")
-                    .arg(QDateTime::currentDateTime().toString("hh:mm:ss.zzz"))
-                    .arg(socket->peerAddress().toString())
-                    .arg(m_address.address.toString()),
-                    QtWarningMsg);
-            socket->disconnectFromHost();
-            return;
-        }
+        worker->queueFrames(id, frames);
+    }
+    else
+    {
+        worker->writeFrames(id, frames);
     }
+}
 
-    connect(socket, &QTcpSocket::readyRead,
-            this, &TcpServer::slotRead);
+int Server::workersCount(bool sharded) const
+{
+    return sharded ? qMax(1, m_threadsCount)
+                   : 1;
+}
+
+void Server::startWorker(ServerWorker* worker)
+{
+    Q_CHECK_PTR(worker);
 
-    m_clients.insert(socket, QByteArray());
-    addConnection(socket);
+    m_workers.append(worker);
+    if (m_threadsCount > 0)
+    {
+        QThread* thread = new QThread();
+        worker->moveToThread(thread);
+        QObject::connect(thread, &QThread::finished,
+                         worker, &ServerWorker::deleteLater);
+        m_threads.append(thread);
+        thread->start();
+    }
 }
 
-void TcpServer::slotOnDisconnect()
+void Server::stopWorkers()
 {
-    QTcpSocket* socket = qobject_cast<QTcpSocket*>(sender());
-    if (socket != nullptr)
+    for (ServerWorker* each : m_workers)
     {
-        removeConnection(socket);
-        QHash<QTcpSocket*, QByteArray>::iterator founded = m_clients.find(socket);
-        if (founded != m_clients.end())
+        if (each->thread() == QThread::currentThread())
+        {
+            each->closeAll();
+            delete each;
+        }
+        else
         {
-            m_clients.erase(founded);
+            QMetaObject::invokeMethod(each, "closeAll", Qt::BlockingQueuedConnection);
         }
     }
-    sender()->deleteLater();
+    m_workers.clear();
+
+    // обработчики рабочих потоков удаляются по сигналу QThread::finished.
+    for (QThread* each : m_threads)
+    {
+        each->quit();
+        each->wait();
+        delete each;
+    }
+    m_threads.clear();
 }
 
-void TcpServer::slotOnError()
+ServerWorker* Server::leastLoadedWorker() const
 {
-    QTcpSocket* socket = qobject_cast<QTcpSocket*>(sender());
-    if (socket != nullptr)
+    ServerWorker* result = nullptr;
+    for (ServerWorker* each : m_workers)
     {
-        if (socket->error() != QTcpSocket::RemoteHostClosedError)
+        if (   result == nullptr
+            || each->load() < result->load())
         {
-            m_lastError = socket->errorString();
-            logging(tr("%1 - Error %2:%3: %4")
-                    .arg(QDateTime::currentDateTime().toString("hh:mm:ss.zzz"))
-                    .arg(socket->peerAddress().toString())
-                    .arg(socket->peerPort())
-                    .arg(m_lastError),
-                    QtWarningMsg);
+            result = each;
         }
     }
+    return result;
 }
 
-void TcpServer::slotRead()
+void Server::incomingMessage(const Message& message, ConnectionId sender)
 {
-    QTcpSocket* socket = qobject_cast<QTcpSocket*>(sender());
-    if (   socket != nullptr
-        && m_clients.contains(socket))
+    Connection connection;
+    if (!updateConnection(message, sender, &connection))
     {
-        m_clients[socket].append(socket->readAll());
-        tryProcessIncomingMessage(socket);
+        return;
     }
-}
 
-void TcpServer::tryProcessIncomingMessage(QTcpSocket* sender)
-{
-    Q_CHECK_PTR(sender);
+    // содержимое сообщения выводится только на отладочном уровне: построение XML дорого.
+    logging(QtDebugMsg, [&message, &connection]()
+    {
+        Message printable(message);
+        printable.setCodec(Message::Codec::Xml);
+        return qApp->tr("Incoming message from %1:%2:\n%3")
+               .arg(connection.info.addressString())
+               .arg(connection.info.port)
+               .arg(QString::fromUtf8(printable.serialize()));
+    });
 
-    if (m_clients.contains(sender))
+    switch (message.type())
     {
-        QByteArray& receivedBytes = m_clients[sender];
-        if (receivedBytes.isEmpty())
-        {
-            return;
-        }
+    case Message::Type::Subscribe:
+        journal(JournalRecord::Event::Subscribe, sender, connection);
+        break;
+    case Message::Type::Unsubscribe:
+        journal(JournalRecord::Event::Unsubscribe, sender, connection);
+        break;
+    case Message::Type::InfoRequest:
+        journal(JournalRecord::Event::Request, sender, connection, message.generation());
+        break;
+    default:
+        break;
+    }
+
+    if (message.type() != Message::Type::InfoRequest)
+    {
+        return;
+    }
 
-        quint32 expectedSize = 0;
+    QByteArray response;
+    if (!message.filter().isEmpty())
+    {
+        Message filtered;
         {
-            QDataStream input(&receivedBytes, QIODevice::ReadOnly);
-            input >> expectedSize;
+            QReadLocker locker(&m_registryLock);
+            filtered = filteredRoster(message.filter());
         }
-
-        if (   expectedSize > 0
-            && static_cast<quint32>(receivedBytes.size() - sizeof(expectedSize)) >= expectedSize)
+        filtered.setCodec(connection.codec);
+        response = packFrame(::frame(filtered), connection.compressed);
+    }
+    else
+    {
+        QReadLocker locker(&m_registryLock);
+        response = packFrame(rosterUpdate(message.generation(), connection.codec), connection.compressed);
+        if (response.isEmpty())
         {
-            Message message;
-            {
-                QDataStream input(receivedBytes);
-                input >> message;
-            }
-            receivedBytes = receivedBytes.right(receivedBytes.size() - sizeof(expectedSize) - expectedSize);
-
-            switch (message.type())
+            if (   connection.chunked
+                && m_activeConnections.size() > ::clientsPerChunk())
             {
-            case Message::Type::InfoRequest:
-            case Message::Type::InfoResponse:
-                incomingMessage(message, sender);
-                break;
-            case Message::Type::Unknown:
-            case Message::Type::Subscribe:
-            case Message::Type::Unsubscribe:
-            default:
-                break;
+                sendFrames(connection.worker, sender, chunkedSnapshot(connection.codec, connection.compressed));
+                return;
             }
-
-            tryProcessIncomingMessage(sender);
+            response = rosterSnapshot(connection.codec, connection.compressed);
         }
     }
+    sendFrame(connection.worker, sender, response);
 }
 
-UdpServer::UdpServer(const NetworkAddress& address, QObject* parent) :
-    QObject(parent),
-    Server(address),
-    m_incoming(new QUdpSocket(this))
+bool Server::updateConnection(const Message& message, ConnectionId sender, Connection* connection)
 {
-    connect(m_incoming, &QUdpSocket::readyRead,
-            this, &UdpServer::slotReadDatagram);
-    connect(m_incoming, static_cast<void(QUdpSocket::*)(QAbstractSocket::SocketError)>(&QUdpSocket::error),
-            this, &UdpServer::slotOnError);
+    Q_CHECK_PTR(connection);
+
+    // клиент сообщает предпочитаемый формат в каждом запросе, старые клиенты его не указывают.
+    Message::Codec codec = message.preferredCodec();
+    bool chunked = message.acceptsChunks();
+    bool compressed = (   m_compressionThreshold > 0
+                       && message.acceptsCompression());
+    bool changesSubscription = (   message.type() == Message::Type::Subscribe
+                                || message.type() == Message::Type::Unsubscribe);
+    bool subscribed = (message.type() == Message::Type::Subscribe);
+
+    // параметры подключения меняются редко, поэтому обычно запрос обходится блокировкой чтения.
+    {
+        QReadLocker locker(&m_registryLock);
+        const Connection* founded = m_activeConnections.find(sender);
+        if (founded == nullptr)
+        {
+            return false;
+        }
+        if (   founded->codec == codec
+            && founded->chunked == chunked
+            && founded->compressed == compressed
+            && (!changesSubscription || founded->subscribed == subscribed))
+        {
+            *connection = *founded;
+            return true;
+        }
+    }
+
+    QWriteLocker locker(&m_registryLock);
+    Connection* founded = m_activeConnections.find(sender);
+    if (founded == nullptr)
+    {
+        return false;
+    }
+    founded->codec = codec;
+    founded->chunked = chunked;
+    founded->compressed = compressed;
+    if (changesSubscription)
+    {
+        founded->subscribed = subscribed;
+    }
+    *connection = *founded;
+    return true;
 }
 
-UdpServer::~UdpServer()
+QByteArray Server::rosterSnapshot(Message::Codec codec, bool compressed)
 {
-    stop();
+    QMutexLocker locker(&m_snapshotsMutex);
+    const FrameFormat format(codec, compressed);
+    QMap<FrameFormat, QByteArray>::const_iterator founded = m_snapshots.constFind(format);
+    if (founded != m_snapshots.constEnd())
+    {
+        return founded.value();
+    }
+
+    // сжатый кадр получается из несжатого, поэтому список сериализуется один раз для каждого формата кодирования.
+    const FrameFormat plain(codec, false);
+    QByteArray serialized = m_snapshots.value(plain);
+    if (serialized.isEmpty())
+    {
+        Message response = rosterMessage();
+        response.setCodec(codec);
+        serialized = ::frame(response);
+        m_snapshots.insert(plain, serialized);
+    }
+
+    serialized = packFrame(serialized, compressed);
+    m_snapshots.insert(format, serialized);
+    return serialized;
 }
 
-bool UdpServer::run()
+Message Server::rosterMessage() const
 {
-    QHostAddress bindingAddress = (m_address.address == QHostAddress::LocalHost ? m_address.address
-                                                                                : (m_address.address.protocol() == QUdpSocket::IPv6Protocol ? QHostAddress::AnyIPv6
-                                                                                                                                            : QHostAddress::AnyIPv4));
-    bool ok = m_incoming->bind(bindingAddress, m_address.port);
-    m_lastError = ok ? QString::null
-                     : m_incoming->errorString();
-    return ok;
+    Message result(Message::Type::InfoResponse);
+    result.setGeneration(m_generation);
+    result.reserveClientsInfo(static_cast<std::size_t>(m_activeConnections.size()));
+    // клиенты перечисляются в порядке подключения, а не в порядке ячеек таблицы.
+    m_activeConnections.forEachSince(ClientInfo::invalidTime, [&result](const Connection& each)
+    {
+        result.addClientInfo(each.info);
+        return true;
+    });
+    return result;
 }
 
-void UdpServer::finish()
+QList<QByteArray> Server::chunkedSnapshot(Message::Codec codec, bool compressed)
 {
-    m_incoming->close();
+    QMutexLocker locker(&m_snapshotsMutex);
+    const FrameFormat format(codec, compressed);
+    QMap<FrameFormat, QList<QByteArray>>::const_iterator founded = m_chunkedSnapshots.constFind(format);
+    if (founded != m_chunkedSnapshots.constEnd())
+    {
+        return founded.value();
+    }
+
+    const FrameFormat plain(codec, false);
+    QList<QByteArray> frames = m_chunkedSnapshots.value(plain);
+    if (frames.isEmpty())
+    {
+        frames = rosterChunks(codec, false);
+        m_chunkedSnapshots.insert(plain, frames);
+    }
 
-    QHash<NetworkAddress, std::tuple<QUdpSocket*, QByteArray>>::iterator it = m_clients.begin();
-    while (it != m_clients.end())
+    if (compressed)
     {
-        QUdpSocket* each = std::get<QUdpSocket*>(*it);
-        if (each != nullptr)
+        for (QByteArray& each : frames)
         {
-            removeConnection(each);
-            each->close();
-            each->deleteLater();
+            each = packFrame(each, compressed);
         }
-        it = m_clients.erase(it);
+        m_chunkedSnapshots.insert(format, frames);
     }
+    return frames;
 }
 
-void UdpServer::slotReadDatagram()
+QByteArray Server::packFrame(const QByteArray& frame, bool compressed) const
 {
-    NetworkAddress peer;
-    QByteArray datagram;
+    return (compressed ? Message::compressFrame(frame, m_compressionThreshold)
+                       : frame);
+}
 
-    while (m_incoming->hasPendingDatagrams())
+QList<QByteArray> Server::rosterChunks(Message::Codec codec, bool pushed) const
+{
+    QList<QByteArray> result;
+
+    Message message(Message::Type::InfoBegin);
+    message.setCodec(codec);
+    message.setGeneration(m_generation);
+    message.setPushed(pushed);
+    message.setTotalClients(static_cast<quint64>(m_activeConnections.size()));
+    result.append(::frame(message));
+
+    message.setType(Message::Type::InfoChunk);
+    message.setTotalClients(0);
+    message.reserveClientsInfo(static_cast<std::size_t>(::clientsPerChunk()));
+    m_activeConnections.forEachSince(ClientInfo::invalidTime, [&result, &message](const Connection& each)
     {
-        datagram.resize(m_incoming->pendingDatagramSize());
-        m_incoming->readDatagram(datagram.data(), datagram.size(), &peer.address, &peer.port);
-        if (   m_address.address != QHostAddress::LocalHost
-            && m_address.address != QHostAddress::Any)
+        message.addClientInfo(each.info);
+        if (message.clientsInfo().size() == static_cast<std::size_t>(::clientsPerChunk()))
         {
-            if (peer.address != m_address.address)
-            {
-                logging(tr("%1 - Discard connection from %2. Expected only %3.")
-                        .arg(QDateTime::currentDateTime().toString("hh:mm:ss.zzz"))
-                        .arg(peer.address.toString())
-                        .arg(m_address.address.toString()),
-                        QtWarningMsg);
-                continue;
-            }
+            result.append(::frame(message));
+            message.resetClientsInfo();
         }
+        return true;
+    });
+    if (!message.clientsInfo().empty())
+    {
+        result.append(::frame(message));
+        message.resetClientsInfo();
+    }
+
+    message.setType(Message::Type::InfoEnd);
+    result.append(::frame(message));
+    return result;
+}
+
+QByteArray Server::rosterUpdate(quint64 knownGeneration, Message::Codec codec) const
+{
+    if (   knownGeneration == 0
+        || knownGeneration > m_generation)
+    {
+        return QByteArray();
+    }
 
-        if (!m_clients.contains(peer))
+    Message response(Message::Type::InfoNotModified);
+    if (knownGeneration < m_generation)
+    {
+        response.setType(Message::Type::InfoDelta);
+        if (!rosterDelta(knownGeneration, &response))
         {
-            m_clients.insert(peer, std::make_tuple(static_cast<QUdpSocket*>(nullptr), QByteArray()));
+            return QByteArray();
         }
-        std::get<QByteArray>(m_clients[peer]).append(datagram);
-
-        tryProcessIncomingMessage(peer);
     }
+    response.setCodec(codec);
+    response.setGeneration(m_generation);
+    return ::frame(response);
 }
 
-void UdpServer::tryProcessIncomingMessage(const NetworkAddress& peer)
+Message Server::filteredRoster(const RosterFilter& filter) const
 {
-    if (   !m_clients.contains(peer)
-        || std::get<QByteArray>(m_clients[peer]).isEmpty())
+    Message result(Message::Type::InfoResponse);
+    result.setGeneration(m_generation);
+
+    const RosterFilter::Transport served = (transport() == QAbstractSocket::TcpSocket ? RosterFilter::Transport::Tcp
+                                                                                      : RosterFilter::Transport::Udp);
+    if (   filter.transport != RosterFilter::Transport::Any
+        && filter.transport != served)
     {
-        return;
+        return result;
     }
 
-    QByteArray& receivedBytes = std::get<QByteArray>(m_clients[peer]);
-    quint32 expectedSize = 0;
+    quint32 skipped = 0;
+    auto page = [&filter, &skipped, &result](const ClientInfo& info)
+    {
+        if (skipped < filter.offset)
+        {
+            ++skipped;
+            return true;
+        }
+        result.addClientInfo(info);
+        return (   filter.limit == 0
+                || result.clientsInfo().size() < filter.limit);
+    };
+
+    if (filter.prefixLength < 0)
     {
-        QDataStream input(&receivedBytes, QIODevice::ReadOnly);
-        input >> expectedSize;
+        // страницы отсчитываются в порядке подключения, поэтому обход идёт по индексу времени подключения;
+        // начало обхода находится двоичным поиском, и подключившиеся раньше since не просматриваются.
+        m_activeConnections.forEachSince(filter.since, [&filter, &page](const Connection& each)
+        {
+            return (   !filter.accepts(each.info)
+                    || page(each.info));
+        });
+        return result;
     }
-    if (   expectedSize > 0
-        && static_cast<quint32>(receivedBytes.size() - sizeof(expectedSize)) >= expectedSize)
+
+    std::array<quint8, 16> first;
+    std::array<quint8, 16> last;
+    filter.subnetRange(first.data(), last.data());
+
+    ClientInfoList matched;
+    for (auto it = m_addressIndex.lower_bound(first), end = m_addressIndex.upper_bound(last); it != end; ++it)
     {
-        Message message;
+        const Connection* each = m_activeConnections.find(it->second);
+        if (   each != nullptr
+            && filter.accepts(each->info))
         {
-            QDataStream input(receivedBytes);
-            input >> message;
+            matched.push_back(each->info);
         }
-        receivedBytes = receivedBytes.right(receivedBytes.size() - sizeof(expectedSize) - expectedSize);
-
-        switch (message.type())
+    }
+    std::stable_sort(matched.begin(), matched.end(), [](const ClientInfo& lhs, const ClientInfo& rhs)
+    {
+        return lhs.connected < rhs.connected;
+    });
+    for (const ClientInfo& each : matched)
+    {
+        if (!page(each))
         {
-        case Message::Type::InfoRequest:
-        case Message::Type::InfoResponse:
-            {
-                QUdpSocket* backSocket = std::get<QUdpSocket*>(m_clients[peer]);
-                if (backSocket != nullptr)
-                {
-                    incomingMessage(message, backSocket);
-                }
-            }
-            break;
-        case Message::Type::Subscribe:
-            addSubscriber(peer, message.backwardPort());
-            break;
-        case Message::Type::Unsubscribe:
-            removeSubscriber(peer);
-            break;
-        case Message::Type::Unknown:
-        default:
             break;
         }
-
-        tryProcessIncomingMessage(peer);
     }
+    return result;
 }
 
-void UdpServer::addSubscriber(const NetworkAddress& peer, quint16 peerIncomingPort)
+bool Server::rosterDelta(quint64 since, Message* delta) const
 {
-    if (   m_clients.contains(peer)
-        && std::get<QUdpSocket*>(m_clients[peer]) == nullptr)
-    {
-        QUdpSocket* socket = new QUdpSocket(this);
-        connect(socket, static_cast<void(QUdpSocket::*)(QAbstractSocket::SocketError)>(&QUdpSocket::error),
-                this, &UdpServer::slotOnError);
+    Q_CHECK_PTR(delta);
 
-        socket->connectToHost(peer.address, peerIncomingPort);
-        std::get<QUdpSocket*>(m_clients[peer]) = socket;
-
-        addConnection(socket);
+    if (   m_history.isEmpty()
+        || m_history.first().generation > since + 1)
+    {
+        return false;
     }
-}
 
-void UdpServer::removeSubscriber(const NetworkAddress& peer)
-{
-    if (m_clients.contains(peer))
+    ClientInfoList added;
+    ClientInfoList removed;
+    for (const RosterChange& each : m_history)
     {
-        QUdpSocket* socket = std::get<QUdpSocket*>(m_clients[peer]);
-        if (socket != nullptr)
+        if (each.generation <= since)
         {
-            removeConnection(socket);
-            socket->close();
-            socket->deleteLater();
-            m_clients.remove(peer);
+            continue;
         }
-    }
-}
 
-void UdpServer::slotOnError()
-{
-    QUdpSocket* socket = qobject_cast<QUdpSocket*>(sender());
+        if (each.added)
+        {
+            added.push_back(each.info);
+            continue;
+        }
+
+        ClientInfoList::iterator founded = std::find(added.begin(), added.end(), each.info);
+        if (founded != added.end())
+        {
+            added.erase(founded);
+        }
+        else
+        {
+            removed.push_back(each.info);
+        }
+    }
+
+    if (added.size() + removed.size() >= static_cast<std::size_t>(m_activeConnections.size()))
+    {
+        return false;
+    }
+
+    delta->setClientsInfo(std::move(added));
+    delta->setRemovedClientsInfo(std::move(removed));
+    return true;
+}
+
+void Server::registerChange(bool added, const ClientInfo& info)
+{
+    ++m_generation;
+    // изменения выполняются под блокировкой записи, поэтому кэш ответов никто не читает.
+    m_snapshots.clear();
+    m_chunkedSnapshots.clear();
+
+    RosterChange change;
+    change.generation = m_generation;
+    change.added = added;
+    change.info = info;
+    m_history.append(change);
+    while (m_history.size() > ::historyDepth())
+    {
+        m_history.removeFirst();
+    }
+
+    // изменения, произошедшие до срабатывания таймера, попадут в то же уведомление.
+    // таймер принадлежит главному потоку, из рабочих потоков он запускается через очередь событий.
+    if (   m_pushEnabled
+        && m_pushScheduled.testAndSetOrdered(0, 1))
+    {
+        QMetaObject::invokeMethod(m_pushTimer.get(), "start");
+    }
+}
+
+void Server::pushRoster()
+{
+    m_pushScheduled.storeRelease(0);
+
+    QReadLocker locker(&m_registryLock);
+    const bool chunking = (m_activeConnections.size() > ::clientsPerChunk());
+    Message push;
+
+    QMap<FrameFormat, QByteArray> frames;
+    QMap<FrameFormat, QList<QByteArray>> chunks;
+    for (ConnectionTable<Connection>::const_iterator it = m_activeConnections.begin(); it != m_activeConnections.end(); ++it)
+    {
+        const Connection& each = it.value();
+        if (!each.subscribed)
+        {
+            continue;
+        }
+
+        const FrameFormat format(each.codec, each.compressed);
+        const FrameFormat plain(each.codec, false);
+        if (   chunking
+            && each.chunked)
+        {
+            QMap<FrameFormat, QList<QByteArray>>::iterator founded = chunks.find(format);
+            if (founded == chunks.end())
+            {
+                QList<QByteArray> packed = chunks.value(plain);
+                if (packed.isEmpty())
+                {
+                    packed = rosterChunks(each.codec, true);
+                    chunks.insert(plain, packed);
+                }
+                for (QByteArray& chunk : packed)
+                {
+                    chunk = packFrame(chunk, each.compressed);
+                }
+                founded = chunks.insert(format, packed);
+            }
+            sendFrames(each.worker, it.key(), founded.value());
+            continue;
+        }
+
+        QMap<FrameFormat, QByteArray>::iterator founded = frames.find(format);
+        if (founded == frames.end())
+        {
+            QByteArray serialized = frames.value(plain);
+            if (serialized.isEmpty())
+            {
+                // полный список формируется, только если есть подписчик, принимающий его целиком.
+                if (push.type() == Message::Type::Unknown)
+                {
+                    push = rosterMessage();
+                    push.setPushed(true);
+                }
+                push.setCodec(each.codec);
+                serialized = ::frame(push);
+                frames.insert(plain, serialized);
+            }
+            founded = frames.insert(format, packFrame(serialized, each.compressed));
+        }
+        sendFrame(each.worker, it.key(), founded.value());
+    }
+}
+
+void Server::journal(JournalRecord::Event event, ConnectionId id, const Connection& connection, quint64 generation)
+{
+    if (!m_journal.isOpen())
+    {
+        return;
+    }
+
+    JournalRecord record;
+    record.event = event;
+    record.connection = id;
+    record.generation = generation;
+    std::memcpy(record.address, connection.info.address, sizeof(record.address));
+    record.port = connection.info.port;
+    record.transport = transport();
+    record.codec = connection.codec;
+    m_journal.append(record);
+}
+
+void Server::logging(const QString& message, QtMsgType type) const
+{
+    m_logWriter->write(type, message);
+}
+
+bool Server::isLogging(QtMsgType type) const
+{
+    return m_logWriter->isEnabled(type);
+}
+
+ServerWorker::ServerWorker(QObject* parent) :
+    QObject(parent)
+{
+    connect(this, &ServerWorker::frameQueued,
+            this, &ServerWorker::slotWriteFrame,
+            Qt::QueuedConnection);
+    connect(this, &ServerWorker::framesQueued,
+            this, &ServerWorker::slotWriteFrames,
+            Qt::QueuedConnection);
+}
+
+int ServerWorker::load() const
+{
+    return m_load.loadAcquire();
+}
+
+void ServerWorker::queueFrame(ConnectionId id, const QByteArray& frame)
+{
+    emit frameQueued(id, frame);
+}
+
+void ServerWorker::queueFrames(ConnectionId id, const QList<QByteArray>& frames)
+{
+    emit framesQueued(id, frames);
+}
+
+void ServerWorker::writeFrames(ConnectionId id, const QList<QByteArray>& frames)
+{
+    for (const QByteArray& each : frames)
+    {
+        writeFrame(id, each);
+    }
+}
+
+void ServerWorker::slotWriteFrame(ConnectionId id, const QByteArray& frame)
+{
+    writeFrame(id, frame);
+}
+
+void ServerWorker::slotWriteFrames(ConnectionId id, const QList<QByteArray>& frames)
+{
+    writeFrames(id, frames);
+}
+
+TcpListener::TcpListener(QObject* parent) :
+    QTcpServer(parent)
+{
+
+}
+
+void TcpListener::incomingConnection(qintptr descriptor)
+{
+    emit descriptorAccepted(descriptor);
+}
+
+TcpWorker::TcpWorker(TcpServer* server) :
+    ServerWorker(),
+    m_server(server)
+{
+    Q_CHECK_PTR(server);
+
+    connect(this, &TcpWorker::descriptorQueued,
+            this, &TcpWorker::slotAddDescriptor,
+            Qt::QueuedConnection);
+}
+
+bool TcpWorker::listen(const QHostAddress& address, quint16 port, QString* error)
+{
+    Q_CHECK_PTR(error);
+
+    qintptr descriptor = NativeSocket::openBound(QAbstractSocket::TcpSocket, address, port, true, error);
+    if (descriptor < 0)
+    {
+        return false;
+    }
+
+    m_listener = new TcpListener(this);
+    if (!m_listener->setSocketDescriptor(descriptor))
+    {
+        *error = m_listener->errorString();
+        NativeSocket::close(descriptor);
+        return false;
+    }
+    connect(m_listener, &TcpListener::descriptorAccepted,
+            this, &TcpWorker::queueDescriptor);
+    return true;
+}
+
+void TcpWorker::queueDescriptor(qintptr descriptor)
+{
+    m_load.ref();
+    emit descriptorQueued(descriptor);
+}
+
+void TcpWorker::closeAll()
+{
+    if (m_listener != nullptr)
+    {
+        m_listener->close();
+    }
+
+    for (Client& client : m_clients)
+    {
+        if (client.id == 0)
+        {
+            continue;
+        }
+        QTcpSocket* each = client.socket;
+        ConnectionId id = client.id;
+        removeClient(client);
+        m_load.deref();
+        // клиент удаляется из списка сразу: поток обработчика может завершиться раньше, чем сокет сообщит об отключении.
+        m_server->removeConnection(id);
+        each->disconnectFromHost();
+    }
+}
+
+TcpWorker::Client* TcpWorker::findClient(ConnectionId id)
+{
+    const std::size_t index = static_cast<std::size_t>(connectionHandle(id));
+    // идентификатор сверяется целиком: дескриптор мог достаться более новому подключению.
+    return (   index < m_clients.size()
+            && m_clients[index].id == id ? &m_clients[index]
+                                         : nullptr);
+}
+
+TcpWorker::Client* TcpWorker::findClient(QTcpSocket* socket)
+{
+    bool ok = false;
+    const ConnectionId id = socket->property(::connectionIdProperty()).toULongLong(&ok);
+    return (ok ? findClient(id)
+               : nullptr);
+}
+
+void TcpWorker::removeClient(Client& client)
+{
+    client.socket->setProperty(::connectionIdProperty(), QVariant());
+    client = Client();
+}
+
+void TcpWorker::writeFrame(ConnectionId id, const QByteArray& frame)
+{
+    // к моменту обработки кадра клиент мог отключиться.
+    Client* founded = findClient(id);
+    if (founded != nullptr)
+    {
+        send(founded->socket, frame);
+    }
+}
+
+void TcpWorker::writeFrames(ConnectionId id, const QList<QByteArray>& frames)
+{
+    // к моменту обработки кадров клиент мог отключиться.
+    Client* founded = findClient(id);
+    if (founded == nullptr)
+    {
+        return;
+    }
+    Client& client = *founded;
+    const qintptr descriptor = client.socket->socketDescriptor();
+
+    // кадр, отправленный целиком одним вызовом, опция не задерживает, поэтому она нужна только для нескольких кадров.
+    if (   m_server->m_tcpCork
+        && !client.corked
+        && frames.size() > 1)
+    {
+        client.corked = NativeSocket::setCork(descriptor, true);
+    }
+
+    for (const QByteArray& each : frames)
+    {
+        send(client.socket, each);
+    }
+
+    // остаток в буфере QTcpSocket ещё не передан ядру: опция снимется в slotOnBytesWritten.
+    if (   client.corked
+        && client.socket->bytesToWrite() == 0)
+    {
+        NativeSocket::setCork(descriptor, false);
+        client.corked = false;
+    }
+}
+
+void TcpWorker::send(QTcpSocket* socket, const QByteArray& frame)
+{
+    const qintptr descriptor = socket->socketDescriptor();
+
+    qint64 sent = 0;
+    if (socket->bytesToWrite() == 0)
+    {
+        // ошибка отправки не обрабатывается здесь: о ней сообщит QTcpSocket при записи кадра целиком.
+        sent = qMax(Q_INT64_C(0), NativeSocket::send(descriptor, &frame, 1));
+    }
+    if (sent < frame.size())
+    {
+        socket->write(sent == 0 ? frame
+                                : frame.mid(static_cast<int>(sent)));
+    }
+}
+
+void TcpWorker::slotAddDescriptor(qintptr descriptor)
+{
+    QTcpSocket* socket = new QTcpSocket(this);
+    if (!socket->setSocketDescriptor(descriptor))
+    {
+        m_server->logging(tr("Failed accept connection: %1")
+                          .arg(socket->errorString()),
+                          QtWarningMsg);
+        m_load.deref();
+        delete socket;
+        return;
+    }
+
+    connect(socket, static_cast<void(QTcpSocket::*)(QAbstractSocket::SocketError)>(&QTcpSocket::error),
+            this, &TcpWorker::slotOnError);
+    connect(socket, &QTcpSocket::disconnected,
+            this, &TcpWorker::slotOnDisconnect);
+    connect(socket, &QTcpSocket::bytesWritten,
+            this, &TcpWorker::slotOnBytesWritten);
+    if (m_server->m_tcpNoDelay)
+    {
+        socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+    }
+
+    const NetworkAddress& address = m_server->m_address;
+    if (   address.address != QHostAddress::LocalHost
+        && address.address != QHostAddress::Any)
+    {
+        if (socket->peerAddress() != address.address)
+        {
+            m_server->logging(QtWarningMsg, [socket, &address]()
+            {
+                return tr("Discard connection from %1. Expected only %2.")
+                       .arg(socket->peerAddress().toString())
+                       .arg(address.address.toString());
+            });
+            m_load.deref();
+            socket->disconnectFromHost();
+            return;
+        }
+    }
+
+    connect(socket, &QTcpSocket::readyRead,
+            this, &TcpWorker::slotRead);
+
+    const ConnectionId id = m_server->addConnection(this, NetworkAddress(socket->peerAddress(), socket->peerPort()));
+    const std::size_t index = static_cast<std::size_t>(connectionHandle(id));
+    if (index >= m_clients.size())
+    {
+        m_clients.resize(index + 1);
+    }
+    Client& client = m_clients[index];
+    client = Client();
+    client.id = id;
+    client.socket = socket;
+    socket->setProperty(::connectionIdProperty(), id);
+}
+
+void TcpWorker::slotOnDisconnect()
+{
+    QTcpSocket* socket = qobject_cast<QTcpSocket*>(sender());
     if (socket != nullptr)
     {
-        m_lastError = socket->errorString();
-        logging(tr("%1 - Error [%2:%3]: %4")
-                .arg(QDateTime::currentDateTime().toString("hh:mm:ss.zzz"))
-                .arg(socket->peerAddress().toString())
-                .arg(socket->peerPort())
-                .arg(m_lastError),
-                QtWarningMsg);
+        Client* founded = findClient(socket);
+        if (founded != nullptr)
+        {
+            ConnectionId id = founded->id;
+            removeClient(*founded);
+            m_load.deref();
+            m_server->removeConnection(id);
+        }
     }
+    sender()->deleteLater();
+}
+
+void TcpWorker::slotOnError()
+{
+    QTcpSocket* socket = qobject_cast<QTcpSocket*>(sender());
+    if (socket != nullptr)
+    {
+        if (socket->error() != QTcpSocket::RemoteHostClosedError)
+        {
+            m_server->setLastError(socket->errorString());
+            m_server->logging(QtWarningMsg, [socket]()
+            {
+                return tr("Error %1:%2: %3")
+                       .arg(socket->peerAddress().toString())
+                       .arg(socket->peerPort())
+                       .arg(socket->errorString());
+            });
+        }
+    }
+}
+
+void TcpWorker::slotOnBytesWritten()
+{
+    // кадры ответа, отправленные с опцией TCP_CORK, полностью переданы ядру - неполный последний сегмент больше не задерживается.
+    QTcpSocket* socket = qobject_cast<QTcpSocket*>(sender());
+    if (   socket != nullptr
+        && socket->bytesToWrite() == 0)
+    {
+        Client* founded = findClient(socket);
+        if (   founded != nullptr
+            && founded->corked)
+        {
+            NativeSocket::setCork(socket->socketDescriptor(), false);
+            founded->corked = false;
+        }
+    }
+}
+
+void TcpWorker::slotRead()
+{
+    QTcpSocket* socket = qobject_cast<QTcpSocket*>(sender());
+    if (socket != nullptr)
+    {
+        Client* founded = findClient(socket);
+        if (founded != nullptr)
+        {
+            founded->decoder.append(socket->readAll());
+            tryProcessIncomingMessage(socket);
+        }
+    }
+}
+
+void TcpWorker::tryProcessIncomingMessage(QTcpSocket* sender)
+{
+    Q_CHECK_PTR(sender);
+
+    Client* founded = findClient(sender);
+    if (founded == nullptr)
+    {
+        return;
+    }
+
+    const ConnectionId id = founded->id;
+    FrameDecoder& decoder = founded->decoder;
+    Message message;
+    while (decoder.next(&message))
+    {
+        switch (message.type())
+        {
+        case Message::Type::InfoRequest:
+        case Message::Type::InfoResponse:
+        case Message::Type::Subscribe:
+        case Message::Type::Unsubscribe:
+            m_server->incomingMessage(message, id);
+            break;
+        case Message::Type::Unknown:
+        default:
+            break;
+        }
+    }
+
+    if (decoder.isCorrupted())
+    {
+        m_server->logging(QtWarningMsg, [sender]()
+        {
+            return tr("Discard connection from %1:%2: frame exceeds %3 bytes")
+                   .arg(sender->peerAddress().toString())
+                   .arg(sender->peerPort())
+                   .arg(Message::maxFrameSize);
+        });
+        sender->disconnectFromHost();
+    }
+}
+
+TcpServer::TcpServer(const NetworkAddress& address, QObject* parent) :
+    QObject(parent),
+    Server(address),
+    m_srv(new TcpListener(this))
+{
+    connect(m_srv, &TcpListener::descriptorAccepted,
+            this, &TcpServer::slotOnNewConnect);
+}
+
+TcpServer::~TcpServer()
+{
+    stop();
+}
+
+QAbstractSocket::SocketType TcpServer::transport() const
+{
+    return QAbstractSocket::TcpSocket;
+}
+
+bool TcpServer::run()
+{
+    QHostAddress listeningAddress = (m_address.address == QHostAddress::LocalHost ? m_address.address
+                                                                                  : (m_address.address.protocol() == QTcpSocket::IPv6Protocol ? QHostAddress::AnyIPv6
+                                                                                                                                              : QHostAddress::AnyIPv4));
+    if (   !m_reusePort
+        && !m_srv->listen(listeningAddress, m_address.port))
+    {
+        setLastError(m_srv->errorString());
+        return false;
+    }
+
+    for (int i = 0, count = workersCount(true); i < count; ++i)
+    {
+        TcpWorker* worker = new TcpWorker(this);
+        QString error;
+        if (   m_reusePort
+            && !worker->listen(listeningAddress, m_address.port, &error))
+        {
+            delete worker;
+            finish();
+            setLastError(error);
+            return false;
+        }
+        startWorker(worker);
+    }
+
+    setLastError(QString::null);
+    return true;
+}
+
+void TcpServer::finish()
+{
+    m_srv->close();
+    stopWorkers();
+}
+
+void TcpServer::slotOnNewConnect(qintptr descriptor)
+{
+    TcpWorker* worker = static_cast<TcpWorker*>(leastLoadedWorker());
+    if (worker != nullptr)
+    {
+        worker->queueDescriptor(descriptor);
+    }
+    else
+    {
+        NativeSocket::close(descriptor);
+    }
+}
+
+UdpWorker::UdpWorker(UdpServer* server) :
+    ServerWorker(),
+    m_server(server)
+{
+    Q_CHECK_PTR(server);
+}
+
+UdpWorker::~UdpWorker()
+{
+    NativeSocket::close(m_descriptor);
+}
+
+bool UdpWorker::bind(const QHostAddress& address, quint16 port, bool reusePort, bool batched, QString* error)
+{
+    Q_CHECK_PTR(error);
+
+    if (batched)
+    {
+        if (!NativeSocket::DatagramBatch::isSupported())
+        {
+            *error = tr("Batched datagram I/O is not supported on this platform");
+            return false;
+        }
+
+        m_descriptor = NativeSocket::openBound(QAbstractSocket::UdpSocket, address, port, reusePort, error);
+        if (m_descriptor < 0)
+        {
+            return false;
+        }
+        m_batch.reset(new NativeSocket::DatagramBatch());
+        m_notifier = new QSocketNotifier(m_descriptor, QSocketNotifier::Read, this);
+        connect(m_notifier, &QSocketNotifier::activated,
+                this, &UdpWorker::slotReadBatch);
+        return true;
+    }
+
+    m_incoming = new QUdpSocket(this);
+    connect(m_incoming, &QUdpSocket::readyRead,
+            this, &UdpWorker::slotReadDatagram);
+    connect(m_incoming, static_cast<void(QUdpSocket::*)(QAbstractSocket::SocketError)>(&QUdpSocket::error),
+            this, &UdpWorker::slotOnError);
+
+    if (!reusePort)
+    {
+        bool ok = m_incoming->bind(address, port);
+        *error = ok ? QString::null
+                    : m_incoming->errorString();
+        return ok;
+    }
+
+    qintptr descriptor = NativeSocket::openBound(QAbstractSocket::UdpSocket, address, port, true, error);
+    if (descriptor < 0)
+    {
+        return false;
+    }
+    if (!m_incoming->setSocketDescriptor(descriptor, QAbstractSocket::BoundState))
+    {
+        *error = m_incoming->errorString();
+        NativeSocket::close(descriptor);
+        return false;
+    }
+    return true;
+}
+
+void UdpWorker::writeFrame(ConnectionId id, const QByteArray& frame)
+{
+    // к моменту обработки кадра клиент мог отписаться.
+    QHash<ConnectionId, NetworkAddress>::const_iterator founded = m_subscribers.constFind(id);
+    if (founded == m_subscribers.constEnd())
+    {
+        return;
+    }
+
+    // ответы всем подписчикам уходят через сокет обработчика, отдельные сокеты для подписчиков не создаются.
+    const NetworkAddress& destination = founded.value();
+    if (m_batch == nullptr)
+    {
+        m_incoming->writeDatagram(frame, destination.address, destination.port);
+        return;
+    }
+
+    // в пакетном режиме ответы копятся до возврата в цикл событий и уходят одним системным вызовом.
+    if (!m_batch->append(destination.address, destination.port, frame))
+    {
+        slotFlushBatch();
+        m_batch->append(destination.address, destination.port, frame);
+    }
+    if (!m_flushScheduled)
+    {
+        m_flushScheduled = true;
+        QMetaObject::invokeMethod(this, "slotFlushBatch", Qt::QueuedConnection);
+    }
+}
+
+void UdpWorker::closeAll()
+{
+    if (m_incoming != nullptr)
+    {
+        m_incoming->close();
+    }
+    if (m_notifier != nullptr)
+    {
+        m_notifier->setEnabled(false);
+    }
+
+    QHash<ConnectionId, NetworkAddress>::iterator it = m_subscribers.begin();
+    while (it != m_subscribers.end())
+    {
+        m_server->removeConnection(it.key());
+        m_load.deref();
+        it = m_subscribers.erase(it);
+    }
+    m_clients.clear();
+
+    slotFlushBatch();
+    NativeSocket::close(m_descriptor);
+    m_descriptor = -1;
+}
+
+void UdpWorker::slotReadDatagram()
+{
+    NetworkAddress peer;
+    QByteArray datagram;
+
+    while (m_incoming->hasPendingDatagrams())
+    {
+        datagram.resize(m_incoming->pendingDatagramSize());
+        m_incoming->readDatagram(datagram.data(), datagram.size(), &peer.address, &peer.port);
+        processDatagram(peer, datagram.constData(), datagram.size());
+    }
+}
+
+void UdpWorker::slotReadBatch()
+{
+    NetworkAddress peer;
+    int count = 0;
+    // ограничение числа пакетов за одно уведомление не даёт потоку зависнуть на приёме при непрерывном потоке датаграмм.
+    for (int round = 0; round < ::maxBatchesPerRead(); ++round)
+    {
+        count = m_batch->receive(m_descriptor);
+        for (int i = 0; i < count; ++i)
+        {
+            m_batch->peer(i, &peer.address, &peer.port);
+            processDatagram(peer, m_batch->data(i), m_batch->size(i));
+        }
+        if (count < m_batch->capacity())
+        {
+            break;
+        }
+    }
+
+    if (count < 0)
+    {
+        m_server->logging(tr("Error receiving datagrams: %1")
+                          .arg(qt_error_string()),
+                          QtWarningMsg);
+    }
+}
+
+void UdpWorker::slotFlushBatch()
+{
+    m_flushScheduled = false;
+    if (   m_batch == nullptr
+        || m_batch->isEmpty()
+        || m_descriptor < 0)
+    {
+        return;
+    }
+
+    int sent = m_batch->flush(m_descriptor);
+    if (sent < 0)
+    {
+        m_server->logging(tr("Error sending datagrams: %1")
+                          .arg(qt_error_string()),
+                          QtWarningMsg);
+    }
+}
+
+void UdpWorker::processDatagram(const NetworkAddress& peer, const char* data, int size)
+{
+    const NetworkAddress& address = m_server->m_address;
+    if (   address.address != QHostAddress::LocalHost
+        && address.address != QHostAddress::Any)
+    {
+        if (peer.address != address.address)
+        {
+            m_server->logging(QtWarningMsg, [&peer, &address]()
+            {
+                return tr("Discard connection from %1. Expected only %2.")
+                       .arg(peer.address.toString())
+                       .arg(address.address.toString());
+            });
+            return;
+        }
+    }
+
+    // адрес переводится в двоичный вид и ищется в таблице один раз на датаграмму.
+    const AddressKey key(peer.address, peer.port);
+    Peer& client = m_clients.insert(key);
+    client.decoder.append(data, size);
+
+    tryProcessIncomingMessage(peer, key, client);
+}
+
+void UdpWorker::tryProcessIncomingMessage(const NetworkAddress& peer, const AddressKey& key, Peer& client)
+{
+    Message message;
+    while (client.decoder.next(&message))
+    {
+        switch (message.type())
+        {
+        case Message::Type::InfoRequest:
+        case Message::Type::InfoResponse:
+            if (client.subscription != 0)
+            {
+                m_server->incomingMessage(message, client.subscription);
+            }
+            break;
+        case Message::Type::Subscribe:
+            addSubscriber(peer, client, message.backwardPort());
+            m_server->incomingMessage(message, client.subscription);
+            break;
+        case Message::Type::Unsubscribe:
+            // запись клиента удаляется вместе с оставшимися в ней кадрами.
+            if (removeSubscriber(key, client))
+            {
+                return;
+            }
+            break;
+        case Message::Type::Unknown:
+        default:
+            break;
+        }
+    }
+
+    if (client.decoder.isCorrupted())
+    {
+        // датаграммы не связаны между собой, поэтому следующая разбирается заново.
+        m_server->logging(QtWarningMsg, [&peer]()
+        {
+            return tr("Discard datagram from %1:%2: frame exceeds %3 bytes")
+                   .arg(peer.address.toString())
+                   .arg(peer.port)
+                   .arg(Message::maxFrameSize);
+        });
+        client.decoder.clear();
+    }
+}
+
+void UdpWorker::addSubscriber(const NetworkAddress& peer, Peer& client, quint16 peerIncomingPort)
+{
+    if (client.subscription == 0)
+    {
+        NetworkAddress destination(peer.address, peerIncomingPort);
+        client.subscription = m_server->addConnection(this, destination);
+        m_subscribers.insert(client.subscription, destination);
+        m_load.ref();
+    }
+}
+
+bool UdpWorker::removeSubscriber(const AddressKey& key, Peer& client)
+{
+    if (client.subscription == 0)
+    {
+        return false;
+    }
+
+    ConnectionId id = client.subscription;
+    m_clients.remove(key);
+    m_subscribers.remove(id);
+    m_load.deref();
+    m_server->removeConnection(id);
+    return true;
+}
+
+void UdpWorker::slotOnError()
+{
+    QUdpSocket* socket = qobject_cast<QUdpSocket*>(sender());
+    if (socket != nullptr)
+    {
+        m_server->setLastError(socket->errorString());
+        m_server->logging(QtWarningMsg, [socket]()
+        {
+            return tr("Error [%1:%2]: %3")
+                   .arg(socket->peerAddress().toString())
+                   .arg(socket->peerPort())
+                   .arg(socket->errorString());
+        });
+    }
+}
+
+UdpServer::UdpServer(const NetworkAddress& address, QObject* parent) :
+    QObject(parent),
+    Server(address)
+{
+
+}
+
+UdpServer::~UdpServer()
+{
+    stop();
+}
+
+QAbstractSocket::SocketType UdpServer::transport() const
+{
+    return QAbstractSocket::UdpSocket;
+}
+
+bool UdpServer::run()
+{
+    QHostAddress bindingAddress = (m_address.address == QHostAddress::LocalHost ? m_address.address
+                                                                                : (m_address.address.protocol() == QUdpSocket::IPv6Protocol ? QHostAddress::AnyIPv6
+                                                                                                                                            : QHostAddress::AnyIPv4));
+    // без SO_REUSEPORT датаграммы всех клиентов приходят в один сокет, поэтому обработчик один.
+    for (int i = 0, count = workersCount(m_reusePort); i < count; ++i)
+    {
+        UdpWorker* worker = new UdpWorker(this);
+        QString error;
+        if (!worker->bind(bindingAddress, m_address.port, m_reusePort, m_batchedDatagrams, &error))
+        {
+            delete worker;
+            finish();
+            setLastError(error);
+            return false;
+        }
+        startWorker(worker);
+    }
+
+    setLastError(QString::null);
+    return true;
+}
+
+void UdpServer::finish()
+{
+    stopWorkers();
 }
 
 } // Netcom
@@ -1,23 +1,42 @@
 #ifndef NETCOM_SERVER_H
 #define NETCOM_SERVER_H
 
+#include <array>
+#include <map>
 #include <memory>
-#include <tuple>
+#include <vector>
 
 #include <QAbstractSocket>
+#include <QAtomicInt>
 #include <QDateTime>
 #include <QHostAddress>
 #include <QObject>
 #include <QHash>
+#include <QList>
+#include <QMap>
+#include <QMutex>
+#include <QPair>
+#include <QReadWriteLock>
 #include <QString>
+#include <QTcpServer>
 
-class QTcpServer;
+#include <framedecoder.h>
+#include <protocol.h>
+
+#include "addresstable.h"
+#include "connectiontable.h"
+#include "journal.h"
+#include "logwriter.h"
+#include "nativesocket.h"
+
+class QSocketNotifier;
 class QTcpSocket;
+class QThread;
+class QTimer;
 class QUdpSocket;
 
 namespace Netcom
 {
-class Message;
 
 QAbstractSocket::SocketType protocolFromString(const QString& str);
 
@@ -37,6 +56,8 @@ struct NetworkAddress
     bool operator!= (const NetworkAddress& rhs) const;
 };
 
+class ServerWorker;
+
 /**
  * @class Server
  * @brief Определяет класс сервера, открывающего порт для приёма входящих подключений (TCP/UDP),
@@ -84,56 +105,585 @@ public:
      */
     void setLogFileName(const QString& fileName);
 
+    /**
+     * @brief setLogOverflowPolicy - устанавливает поведение журнала при заполненной очереди записи.
+     * @param policy - ожидать места в очереди, отбрасывать сообщения или отбрасывать с подсчётом.
+     */
+    void setLogOverflowPolicy(LogWriter::OverflowPolicy policy);
+
+    /**
+     * @brief setLogLevel - устанавливает минимальный уровень сообщений журнала.
+     * @param level - тип наименее важного выводимого сообщения
+     *                (QtDebugMsg - выводить также содержимое каждого входящего сообщения).
+     */
+    void setLogLevel(QtMsgType level);
+
+    /**
+     * @brief setLogRotation - устанавливает условия ротации файла журнала.
+     * @param maxSize - размер файла в байтах, при достижении которого начинается новый файл (0 - не ограничен).
+     * @param intervalSec - интервал в секундах, после которого начинается новый файл (0 - не ограничен).
+     * @param keepCount - количество хранимых сжатых сегментов журнала (0 - хранить все).
+     */
+    void setLogRotation(qint64 maxSize, int intervalSec, int keepCount);
+
+    /**
+     * @brief setJournalFileName - устанавливает имя файла двоичного журнала событий списка активных клиентов.
+     * @param fileName - имя файла журнала (пустое - журнал не ведётся).
+     *
+     * @note  Применяется при следующем запуске сервера.
+     */
+    void setJournalFileName(const QString& fileName);
+
+    /**
+     * @brief setPushInterval - устанавливает интервал, в течение которого изменения списка активных клиентов
+     *                          объединяются в одно уведомление подписчиков.
+     * @param msec - интервал в миллисекундах (отрицательное значение - уведомления не отправляются).
+     */
+    void setPushInterval(int msec);
+
+    /**
+     * @brief setThreadsCount - устанавливает количество рабочих потоков для обслуживания подключений.
+     * @param count - количество потоков (0 - подключения обслуживаются в главном потоке).
+     *
+     * @note  Применяется при следующем запуске сервера. UDP-сервер использует несколько потоков
+     *        только в режиме setReusePort, иначе все датаграммы принимаются одним обработчиком.
+     */
+    void setThreadsCount(int count);
+
+    /**
+     * @brief setReusePort - включает режим, в котором каждый обработчик открывает собственный сокет
+     *                       на порту сервера с опцией SO_REUSEPORT, а входящие подключения и датаграммы
+     *                       распределяет между ними ядро.
+     * @param enabled - флаг включения режима.
+     *
+     * @note  Применяется при следующем запуске сервера. Количество обработчиков задаётся setThreadsCount.
+     */
+    void setReusePort(bool enabled);
+
+    /**
+     * @brief setBatchedDatagrams - включает для UDP-сервера пакетный приём и отправку датаграмм (recvmmsg/sendmmsg)
+     *                              вместо QUdpSocket.
+     * @param enabled - флаг включения режима.
+     *
+     * @note  Применяется при следующем запуске сервера. Доступно только в Linux.
+     */
+    void setBatchedDatagrams(bool enabled);
+
+    /**
+     * @brief setTcpNoDelay - устанавливает на TCP-соединениях клиентов опцию TCP_NODELAY,
+     *                        чтобы короткие ответы не задерживались алгоритмом Нейгла.
+     * @param enabled - флаг установки опции.
+     *
+     * @note  Применяется к соединениям, принятым после вызова.
+     */
+    void setTcpNoDelay(bool enabled);
+
+    /**
+     * @brief setTcpCork - включает опцию TCP_CORK на время отправки ответа из нескольких кадров (списка клиентов частями),
+     *                     чтобы небольшие кадры начала и конца передавались в одних сегментах с частями списка.
+     * @param enabled - флаг включения режима.
+     *
+     * @note  Опция устанавливается перед первым кадром ответа и снимается, как только последний кадр полностью
+     *        передан ядру. Доступно только в Linux.
+     */
+    void setTcpCork(bool enabled);
+
+    /**
+     * @brief setCompressionThreshold - включает сжатие кадров для клиентов, которые его поддерживают.
+     * @param bytes - наименьший размер тела кадра, начиная с которого оно сжимается (0 - кадры не сжимаются).
+     *
+     * @note  Применяется к запросам, полученным после вызова. Сжатые кадры списка клиентов кэшируются вместе с несжатыми.
+     */
+    void setCompressionThreshold(int bytes);
+
 protected:
     virtual bool run() = 0;
     virtual void finish() = 0;
 
+    /**
+     * @brief  transport - возвращает тип сервера (TCP/UDP) для журнала событий.
+     */
+    virtual QAbstractSocket::SocketType transport() const = 0;
+
+    /**
+     * @brief  workersCount - возвращает количество обработчиков, которые следует создать при запуске.
+     * @param  sharded - обработчики могут работать независимо друг от друга (TCP или режим setReusePort).
+     * @return количество обработчиков.
+     */
+    int workersCount(bool sharded) const;
+
+    /**
+     * @brief startWorker - запускает обработчик в отдельном рабочем потоке (если они используются)
+     *                      и добавляет его в список обработчиков сервера.
+     * @param worker - обработчик, сервер становится его владельцем.
+     */
+    void startWorker(ServerWorker* worker);
+
+    /**
+     * @brief stopWorkers - закрывает подключения всех обработчиков, останавливает рабочие потоки и удаляет обработчики.
+     */
+    void stopWorkers();
+
+    /**
+     * @brief  leastLoadedWorker - выбирает обработчик с наименьшим количеством подключений.
+     * @return обработчик для нового подключения (nullptr - если сервер не запущен).
+     */
+    ServerWorker* leastLoadedWorker() const;
+
     /**
      * @brief incomingMessage - общий обработчик полученных от клиентов запросов.
      * @param message - запрос для обработки.
      * @param sender - отправитель запроса.
      *
-     * @note  Формирует и отправляет обратно отправителю ответ на запрос информации об активных клиентах.
+     * @note  Формирует и отправляет обратно отправителю ответ на запрос информации об активных клиентах,
+     *        по запросам Subscribe/Unsubscribe включает и отключает отправку ему уведомлений об изменениях.
      */
-    void incomingMessage(const Message& message, QAbstractSocket* sender);
+    void incomingMessage(const Message& message, ConnectionId sender);
 
     /**
-     * @brief addConnection - добавляет клиента в список активных клиентов.
-     * @param socket - добавляемый клиент.
+     * @brief  addConnection - добавляет клиента в список активных клиентов (из любого потока).
+     * @param  worker - обработчик, через который клиенту отправляются кадры.
+     * @param  peer - адрес и порт, на которые клиенту отправляются ответы.
+     * @return идентификатор подключения.
      */
-    void addConnection(QAbstractSocket* socket);
+    ConnectionId addConnection(ServerWorker* worker, const NetworkAddress& peer);
 
     /**
      * @brief removeConnection - удаляет клиента из списка активных клиентов.
-     * @param socket - удаляемый клиент.
+     * @param id - идентификатор подключения.
      */
-    void removeConnection(QAbstractSocket* socket);
+    void removeConnection(ConnectionId id);
 
     /**
      * @brief logging - вывод сообщения в консоль и при необходимости в журнал.
      * @param message - текст выводимого сообщения.
      * @param type - тип выводимого сообщения.
+     *
+     * @note  Сообщение только помещается в очередь, вывод выполняет поток записи журнала.
      */
     void logging(const QString& message, QtMsgType type) const;
 
+    /**
+     * @brief logging - вывод сообщения, текст которого формируется только при включённом уровне.
+     * @param type - тип выводимого сообщения.
+     * @param format - функция без аргументов, возвращающая текст сообщения.
+     */
+    template <typename Formatter>
+    void logging(QtMsgType type, const Formatter& format) const
+    {
+        if (isLogging(type))
+        {
+            logging(format(), type);
+        }
+    }
+
+    /**
+     * @brief  isLogging - проверяет, выводятся ли сообщения указанного типа.
+     * @param  type - тип сообщения.
+     */
+    bool isLogging(QtMsgType type) const;
+
+    /**
+     * @brief setLastError - сохраняет текст сообщения о последней ошибке.
+     * @param error - текст сообщения об ошибке.
+     */
+    void setLastError(const QString& error);
+
+private:
+    /**
+     * @brief  rosterMessage - формирует сообщение InfoResponse со списком активных клиентов.
+     * @return сообщение InfoResponse (клиенты в порядке подключения).
+     *
+     * @note   Здесь и далее до pushRoster: вызывается под блокировкой m_registryLock.
+     */
+    Message rosterMessage() const;
+
+    /**
+     * @brief  rosterSnapshot - возвращает готовый к отправке кадр InfoResponse со списком активных клиентов.
+     * @param  codec - формат кодирования ответа.
+     * @param  compressed - кадр сжимается (см. packFrame).
+     * @return кадр ответа (размер + тело).
+     *
+     * @note   Кадр формируется (и сжимается) один раз для каждого формата и используется для всех запросов
+     *         до следующего изменения списка активных клиентов.
+     */
+    QByteArray rosterSnapshot(Message::Codec codec, bool compressed);
+
+    /**
+     * @brief  rosterChunks - формирует кадры списка активных клиентов, передаваемого частями:
+     *                        InfoBegin, InfoChunk (не более clientsPerChunk клиентов в каждом), InfoEnd.
+     * @param  codec - формат кодирования кадров.
+     * @param  pushed - кадры отправляются подписчикам без запроса.
+     * @return кадры (размер + тело) в порядке отправки.
+     *
+     * @note   Кадры формируются по мере обхода списка в порядке подключения, полное сообщение InfoResponse не создаётся.
+     */
+    QList<QByteArray> rosterChunks(Message::Codec codec, bool pushed) const;
+
+    /**
+     * @brief  chunkedSnapshot - возвращает готовые к отправке кадры rosterChunks для ответа на запрос.
+     * @param  codec - формат кодирования кадров.
+     * @param  compressed - кадры сжимаются (см. packFrame).
+     * @return кадры (размер + тело).
+     *
+     * @note   Кэшируются так же, как rosterSnapshot.
+     */
+    QList<QByteArray> chunkedSnapshot(Message::Codec codec, bool compressed);
+
+    /**
+     * @brief  rosterUpdate - возвращает кадр ответа на InfoRequest для клиента, получившего поколение knownGeneration.
+     * @param  knownGeneration - последнее поколение списка, известное клиенту (0 - не известно).
+     * @param  codec - формат кодирования ответа.
+     * @return кадр InfoNotModified или InfoDelta (размер + тело), пустой массив - если нужен полный список.
+     */
+    QByteArray rosterUpdate(quint64 knownGeneration, Message::Codec codec) const;
+
+    /**
+     * @brief  rosterDelta - заполняет списки клиентов, подключившихся и отключившихся после поколения since.
+     * @param  since - последнее поколение списка, известное клиенту.
+     * @param  delta - заполняемое сообщение InfoDelta.
+     * @return false - если история изменений уже не покрывает since или изменения не меньше полного списка.
+     */
+    bool rosterDelta(quint64 since, Message* delta) const;
+
+    /**
+     * @brief  filteredRoster - формирует сообщение InfoResponse с клиентами, отобранными фильтром запроса.
+     * @param  filter - условия отбора (непустые).
+     * @return сообщение InfoResponse (клиенты в порядке подключения).
+     *
+     * @note   Подсеть выбирается по префиксному индексу m_addressIndex, без подсети клиенты отбираются
+     *         по индексу времени подключения таблицы m_activeConnections начиная с since, поэтому порядок
+     *         добавления и переводы системных часов не влияют на отбор.
+     */
+    Message filteredRoster(const RosterFilter& filter) const;
+
+    /**
+     * @brief registerChange - увеличивает номер поколения списка активных клиентов и сохраняет изменение в истории.
+     * @param added - true - клиент подключился, false - отключился.
+     * @param info - клиент.
+     */
+    void registerChange(bool added, const ClientInfo& info);
+
+    /**
+     * @brief pushRoster - отправляет всем подписчикам текущий список активных клиентов.
+     *
+     * @note  Уведомление сериализуется один раз для каждого формата (и способа передачи - целиком или частями).
+     */
+    void pushRoster();
+
+    /**
+     * @brief  packFrame - сжимает кадр, если клиент принимает сжатые кадры и тело не меньше порога сжатия.
+     * @param  frame - кадр (размер + тело).
+     * @param  compressed - клиент принимает сжатые кадры и сжатие включено.
+     * @return кадр для отправки.
+     */
+    QByteArray packFrame(const QByteArray& frame, bool compressed) const;
+
+    /**
+     * @brief sendFrame - отправляет клиенту готовый кадр.
+     * @param worker - обработчик подключения клиента.
+     * @param id - идентификатор подключения.
+     * @param frame - кадр (размер + тело).
+     *
+     * @note  Может вызываться из любого потока: кадр передаётся потоку обработчика.
+     */
+    void sendFrame(ServerWorker* worker, ConnectionId id, const QByteArray& frame);
+
+    /**
+     * @brief sendFrames - отправляет клиенту последовательность кадров одного ответа.
+     * @param worker - обработчик подключения клиента.
+     * @param id - идентификатор подключения.
+     * @param frames - кадры (размер + тело) в порядке отправки.
+     *
+     * @note  Кадры передаются потоку обработчика вместе, поэтому он отправляет их подряд (см. ServerWorker::writeFrames).
+     */
+    void sendFrames(ServerWorker* worker, ConnectionId id, const QList<QByteArray>& frames);
+
+    /**
+     * @struct Connection
+     * @brief  Параметры активного подключения.
+     */
+    struct Connection;
+
+    /**
+     * @brief  updateConnection - запоминает согласованный формат, приём списка частями, сжатие и признак подписки отправителя запроса.
+     * @param  message - запрос клиента.
+     * @param  sender - отправитель запроса.
+     * @param  connection - параметры подключения отправителя после изменения.
+     * @return false - если отправитель не зарегистрирован.
+     */
+    bool updateConnection(const Message& message, ConnectionId sender, Connection* connection);
+
+    /**
+     * @brief journal - добавляет событие в журнал событий, если он ведётся.
+     * @param event - событие.
+     * @param id - идентификатор подключения.
+     * @param connection - параметры подключения.
+     * @param generation - поколение списка клиентов из запроса.
+     */
+    void journal(JournalRecord::Event event, ConnectionId id, const Connection& connection, quint64 generation = 0);
+
+private:
+    struct Connection
+    {
+        ClientInfo info;                            //!< адрес, порт и время подключения клиента.
+        ServerWorker* worker = nullptr;             //!< обработчик, через который клиенту отправляются кадры.
+        Message::Codec codec = Message::Codec::Xml; //!< формат ответов, согласованный с клиентом.
+        bool chunked = false;                       //!< клиент принимает список клиентов частями.
+        bool compressed = false;                    //!< кадры клиенту сжимаются.
+        bool subscribed = false;                    //!< клиент получает уведомления об изменении списка клиентов.
+    };
+
+    /**
+     * @brief FrameFormat - формат кэшируемых кадров: кодирование тела и признак сжатия.
+     */
+    typedef QPair<Message::Codec, bool> FrameFormat;
+
+    /**
+     * @struct RosterChange
+     * @brief  Изменение списка активных клиентов.
+     */
+    struct RosterChange
+    {
+        quint64 generation = 0; //!< поколение списка после изменения.
+        bool added = false;     //!< true - клиент подключился, false - отключился.
+        ClientInfo info;        //!< клиент.
+    };
+
 protected:
     QString m_lastError;      //!< последнее сообщение об ошибке.
     NetworkAddress m_address; //!< параметры сервера: порт для входящих подключений, ip-адрес разрешённого клиента.
+    int m_threadsCount = 0;   //!< количество рабочих потоков.
+    bool m_reusePort = false; //!< каждый обработчик открывает собственный сокет с опцией SO_REUSEPORT.
+    bool m_batchedDatagrams = false; //!< пакетный обмен датаграммами (recvmmsg/sendmmsg).
+    bool m_tcpNoDelay = false;       //!< опция TCP_NODELAY для принятых соединений.
+    bool m_tcpCork = false;          //!< опция TCP_CORK на время отправки ответа из нескольких кадров.
+    int m_compressionThreshold = 0;  //!< наименьший сжимаемый размер тела кадра (0 - без сжатия).
 
 private:
-    QHash<QAbstractSocket*, QDateTime> m_activeConnections; //!< список активных клиентов со временем их подключения.
-    QString m_logFileName;    //!< имя файла журнала (если пустое - журнал не ведётся).
+    mutable QReadWriteLock m_registryLock; //!< блокировка списка активных клиентов, поколения и истории изменений.
+    ConnectionTable<Connection> m_activeConnections; //!< список активных клиентов с параметрами их подключения (с индексом по времени подключения).
+    std::multimap<std::array<quint8, 16>, ConnectionId> m_addressIndex; //!< подключения, упорядоченные по адресу клиента (для отбора по подсети).
+    mutable QMutex m_snapshotsMutex;      //!< блокировка кэша ответов для читателей, одновременно формирующих кадры.
+    QMap<FrameFormat, QByteArray> m_snapshots; //!< сериализованные ответы InfoResponse для каждого формата (сбрасываются при изменении списка клиентов).
+    QMap<FrameFormat, QList<QByteArray>> m_chunkedSnapshots; //!< сериализованные ответы, передаваемые частями, для каждого формата.
+    quint64 m_generation;                 //!< номер поколения списка активных клиентов.
+    QList<RosterChange> m_history;        //!< последние изменения списка активных клиентов.
+    std::unique_ptr<QTimer> m_pushTimer;  //!< таймер объединения изменений списка клиентов в одно уведомление.
+    QAtomicInt m_pushScheduled;           //!< признак запланированной отправки уведомления.
+    bool m_pushEnabled = true;            //!< признак отправки уведомлений подписчикам.
+    mutable QMutex m_mutex;   //!< блокировка m_lastError.
+    std::unique_ptr<LogWriter> m_logWriter; //!< фоновая запись журнала в консоль и файл.
+    QString m_journalFileName;        //!< имя файла журнала событий.
+    JournalWriter m_journal;          //!< журнал событий списка активных клиентов.
+    QList<QThread*> m_threads;        //!< рабочие потоки.
+    QList<ServerWorker*> m_workers;   //!< обработчики подключений.
+
+};
+
+/**
+ * @class ServerWorker
+ * @brief Обработчик подключений: владеет своими сокетами и обслуживает их в цикле событий своего потока.
+ */
+class ServerWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ServerWorker(QObject* parent = nullptr);
+
+    /**
+     * @brief  load - возвращает количество обслуживаемых подключений.
+     * @return количество подключений, включая переданные, но ещё не принятые обработчиком.
+     */
+    int load() const;
+
+    /**
+     * @brief queueFrame - передаёт кадр для отправки клиенту обработчика (из любого потока).
+     * @param id - идентификатор подключения.
+     * @param frame - кадр (размер + тело).
+     */
+    void queueFrame(ConnectionId id, const QByteArray& frame);
+
+    /**
+     * @brief queueFrames - передаёт последовательность кадров одного ответа (из любого потока).
+     * @param id - идентификатор подключения.
+     * @param frames - кадры (размер + тело) в порядке отправки.
+     */
+    void queueFrames(ConnectionId id, const QList<QByteArray>& frames);
+
+    /**
+     * @brief writeFrame - отправляет кадр клиенту обработчика (только из потока обработчика).
+     * @param id - идентификатор подключения (кадр для уже отключившегося клиента отбрасывается).
+     * @param frame - кадр (размер + тело).
+     */
+    virtual void writeFrame(ConnectionId id, const QByteArray& frame) = 0;
+
+    /**
+     * @brief writeFrames - отправляет клиенту обработчика кадры одного ответа подряд (только из потока обработчика).
+     * @param id - идентификатор подключения.
+     * @param frames - кадры (размер + тело) в порядке отправки.
+     */
+    virtual void writeFrames(ConnectionId id, const QList<QByteArray>& frames);
+
+public slots:
+    /**
+     * @brief closeAll - закрывает приёмник и все обслуживаемые подключения.
+     */
+    virtual void closeAll() = 0;
+
+signals:
+    void frameQueued(ConnectionId id, const QByteArray& frame);
+    void framesQueued(ConnectionId id, const QList<QByteArray>& frames);
+
+private slots:
+    void slotWriteFrame(ConnectionId id, const QByteArray& frame);
+    void slotWriteFrames(ConnectionId id, const QList<QByteArray>& frames);
+
+protected:
+    QAtomicInt m_load; //!< количество обслуживаемых подключений.
+
+};
+
+class TcpServer;
+class UdpServer;
+
+/**
+ * @class TcpListener
+ * @brief Приёмник TCP-подключений, передающий дескрипторы принятых соединений без создания сокетов.
+ *
+ * @note  Сокет создаётся обработчиком в том потоке, который будет его обслуживать.
+ */
+class TcpListener : public QTcpServer
+{
+    Q_OBJECT
+
+public:
+    explicit TcpListener(QObject* parent = nullptr);
+
+signals:
+    void descriptorAccepted(qintptr descriptor);
+
+protected:
+    virtual void incomingConnection(qintptr descriptor) override;
+
+};
+
+/**
+ * @class TcpWorker
+ * @brief Обработчик TCP-подключений.
+ */
+class TcpWorker : public ServerWorker
+{
+    Q_OBJECT
+
+public:
+    explicit TcpWorker(TcpServer* server);
+
+    /**
+     * @brief  listen - открывает собственный приёмник подключений с опцией SO_REUSEPORT.
+     * @param  address - адрес приёма.
+     * @param  port - порт приёма.
+     * @param  error - текст сообщения об ошибке.
+     * @return флаг успешности открытия приёмника.
+     */
+    bool listen(const QHostAddress& address, quint16 port, QString* error);
+
+    /**
+     * @brief queueDescriptor - передаёт принятое соединение обработчику (из любого потока).
+     * @param descriptor - дескриптор принятого соединения.
+     */
+    void queueDescriptor(qintptr descriptor);
+
+    /**
+     * @brief writeFrame - отправляет кадр клиенту.
+     *
+     * @note  Если в буфере сокета нет неотправленных данных, кадр передаётся ядру напрямую (sendmsg),
+     *        без копирования в буфер QTcpSocket; через него отправляется только не принятый ядром остаток.
+     */
+    virtual void writeFrame(ConnectionId id, const QByteArray& frame) override;
+
+    /**
+     * @brief writeFrames - отправляет кадры одного ответа.
+     *
+     * @note  В режиме TCP_CORK опция устанавливается один раз перед первым кадром и снимается после последнего
+     *        (или после передачи ядру остатка из буфера QTcpSocket), поэтому кадры объединяются в полные сегменты.
+     */
+    virtual void writeFrames(ConnectionId id, const QList<QByteArray>& frames) override;
+
+public slots:
+    virtual void closeAll() override;
+
+signals:
+    void descriptorQueued(qintptr descriptor);
+
+private:
+    struct Client;
+
+    void tryProcessIncomingMessage(QTcpSocket* sender);
+
+    /**
+     * @brief  findClient - ищет активное соединение по идентификатору подключения.
+     * @return соединение, nullptr - если клиент уже отключился.
+     */
+    Client* findClient(ConnectionId id);
+
+    /**
+     * @brief  findClient - ищет активное соединение по сокету (идентификатор подключения хранится в свойстве сокета).
+     * @return соединение, nullptr - если сокет не принадлежит активному соединению.
+     */
+    Client* findClient(QTcpSocket* socket);
+
+    /**
+     * @brief removeClient - освобождает запись соединения.
+     */
+    void removeClient(Client& client);
+
+    /**
+     * @brief send - передаёт кадр сокету соединения.
+     */
+    void send(QTcpSocket* socket, const QByteArray& frame);
+
+private slots:
+    void slotAddDescriptor(qintptr descriptor);
+    void slotOnDisconnect();
+    void slotOnError();
+    void slotRead();
+    void slotOnBytesWritten();
+
+private:
+    TcpServer* m_server;                //!< сервер, которому передаются запросы клиентов.
+    /**
+     * @struct Client
+     * @brief  Активное соединение.
+     */
+    struct Client
+    {
+        ConnectionId id = 0;           //!< идентификатор подключения (0 - запись свободна).
+        QTcpSocket* socket = nullptr;  //!< сокет соединения.
+        FrameDecoder decoder;          //!< буфер приёма входящей информации.
+        bool corked = false;           //!< на сокете установлена опция TCP_CORK.
+    };
+
+    TcpListener* m_listener = nullptr;  //!< собственный приёмник подключений (только в режиме SO_REUSEPORT).
+    std::vector<Client> m_clients;      //!< активные соединения по номерам дескрипторов подключений (см. connectionHandle).
 
 };
 
 /**
  * @class TcpServer
  * @brief Реализация TCP-сервера.
+ *
+ * @note  Принятые подключения распределяются между обработчиками TcpWorker:
+ *        по одному в каждом рабочем потоке или одним в главном потоке.
+ *        В режиме SO_REUSEPORT каждый обработчик принимает подключения сам.
  */
 class TcpServer : public QObject, public Server
 {
     Q_OBJECT
 
+    friend class TcpWorker;
+
 public:
     explicit TcpServer(const NetworkAddress& address, QObject* parent = nullptr);
     ~TcpServer();
@@ -141,29 +691,112 @@ public:
 private:
     virtual bool run() override;
     virtual void finish() override;
+    virtual QAbstractSocket::SocketType transport() const override;
 
-    void tryProcessIncomingMessage(QTcpSocket* sender);
+private slots:
+    void slotOnNewConnect(qintptr descriptor);
+
+private:
+    TcpListener* m_srv; //!< общий объект-приёник TCP-подключений.
+
+};
+
+/**
+ * @class UdpWorker
+ * @brief Обработчик UDP-датаграмм: принимает датаграммы на своём сокете и обслуживает подписчиков, приславших их.
+ */
+class UdpWorker : public ServerWorker
+{
+    Q_OBJECT
+
+public:
+    explicit UdpWorker(UdpServer* server);
+    ~UdpWorker();
+
+    /**
+     * @brief  bind - привязывает приёмник датаграмм.
+     * @param  address - адрес приёма.
+     * @param  port - порт приёма.
+     * @param  reusePort - открыть сокет с опцией SO_REUSEPORT.
+     * @param  batched - принимать и отправлять датаграммы пакетами (recvmmsg/sendmmsg).
+     * @param  error - текст сообщения об ошибке.
+     * @return флаг успешности привязки.
+     */
+    bool bind(const QHostAddress& address, quint16 port, bool reusePort, bool batched, QString* error);
+
+    /**
+     * @brief writeFrame - отправляет кадр подписчику датаграммой на его обратный порт.
+     *
+     * @note  В пакетном режиме кадр добавляется в пакет, отправляемый при возврате в цикл событий.
+     */
+    virtual void writeFrame(ConnectionId id, const QByteArray& frame) override;
+
+public slots:
+    virtual void closeAll() override;
 
 private slots:
-    void slotOnNewConnect();
-    void slotOnDisconnect();
     void slotOnError();
-    void slotRead();
+    void slotReadDatagram();
+    void slotReadBatch();
+    void slotFlushBatch();
+
+private:
+    struct Peer;
+
+    void processDatagram(const NetworkAddress& peer, const char* data, int size);
+
+    void addSubscriber(const NetworkAddress& peer, Peer& client, quint16 peerIncomingPort);
+
+    /**
+     * @brief  removeSubscriber - отменяет подписку клиента и удаляет его запись.
+     * @return false - если клиент не был подписан (запись сохраняется).
+     */
+    bool removeSubscriber(const AddressKey& key, Peer& client);
+
+    /**
+     * @brief tryProcessIncomingMessage - обрабатывает полностью принятые кадры клиента.
+     * @param peer - адрес и порт клиента.
+     * @param key - двоичное представление адреса клиента, вычисленное один раз для датаграммы.
+     * @param client - запись клиента в m_clients.
+     */
+    void tryProcessIncomingMessage(const NetworkAddress& peer, const AddressKey& key, Peer& client);
 
 private:
-    QTcpServer* m_srv; //!< объект-приёник TCP-подключений.
-    QHash<QTcpSocket*, QByteArray> m_clients; //!< активные соединения и буферы приёма входящей информации для них.
+    UdpServer* m_server;              //!< сервер, которому передаются запросы клиентов.
+    QUdpSocket* m_incoming = nullptr; //!< объект-приёмник UDP-датаграмм.
+    qintptr m_descriptor = -1;        //!< сокет приёма и отправки датаграмм в пакетном режиме.
+    QSocketNotifier* m_notifier = nullptr; //!< уведомитель о готовых к приёму датаграммах в пакетном режиме.
+    std::unique_ptr<NativeSocket::DatagramBatch> m_batch; //!< буферы пакетного обмена датаграммами.
+    bool m_flushScheduled = false;    //!< отправка накопленного пакета запланирована.
+
+    /**
+     * @struct Peer
+     * @brief  Клиент, приславший датаграммы.
+     */
+    struct Peer
+    {
+        ConnectionId subscription = 0; //!< идентификатор подключения подписчика (0 - клиент не подписан).
+        FrameDecoder decoder;          //!< буфер приёма входящей от клиента информации.
+    };
+
+    AddressTable<Peer> m_clients;                      //!< клиенты, приславшие датаграммы.
+    QHash<ConnectionId, NetworkAddress> m_subscribers; //!< адреса и обратные порты подписчиков.
 
 };
 
 /**
  * @class UdpServer
  * @brief Реализация UDP-сервера.
+ *
+ * @note  В режиме SO_REUSEPORT датаграммы принимаются несколькими обработчиками UdpWorker,
+ *        ядро направляет датаграммы одного клиента всегда в один и тот же сокет.
  */
 class UdpServer : public QObject, public Server
 {
     Q_OBJECT
 
+    friend class UdpWorker;
+
 public:
     explicit UdpServer(const NetworkAddress& address, QObject* parent = nullptr);
     ~UdpServer();
@@ -171,25 +804,13 @@ public:
 private:
     virtual bool run() override;
     virtual void finish() override;
-
-private slots:
-    void slotOnError();
-    void slotReadDatagram();
-
-    void addSubscriber(const NetworkAddress& peer, quint16 peerIncomingPort);
-    void removeSubscriber(const NetworkAddress& peer);
-
-    void tryProcessIncomingMessage(const NetworkAddress& peer);
-
-private:
-    QUdpSocket* m_incoming; //!< объект-приёмник UDP-датаграмм.
-    QHash<NetworkAddress, std::tuple<QUdpSocket*, QByteArray>> m_clients; //!< объекты для отправки сообщений зарегистрировавшимся клиентам и буферы приёма входящей от клиентов информации.
+    virtual QAbstractSocket::SocketType transport() const override;
 
 };
 
 inline uint qHash(const NetworkAddress& key, uint seed = 0)
 {
-    return (::qHash(key.address.toString(), seed) ^ ::qHash(key.port, seed));
+    return AddressKey(key.address, key.port).hash(seed);
 }
 
 } // Netcom
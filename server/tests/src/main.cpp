@@ -0,0 +1,253 @@
+#include <QtTest>
+
+#include <QHostAddress>
+#include <QList>
+
+#include <limits>
+
+#include "addresstable.h"
+#include "connectiontable.h"
+
+namespace
+{
+
+/**
+ * @brief since - возвращает времена подключений, обойдённых ConnectionTable::forEachSince.
+ */
+QList<qint64> since(const Netcom::ConnectionTable<qint64>& table, qint64 time)
+{
+    QList<qint64> result;
+    table.forEachSince(time, [&result](qint64 each)
+    {
+        result.append(each);
+        return true;
+    });
+    return result;
+}
+
+/**
+ * @brief  keysWithHome - подбирает адреса, цепочки которых начинаются в заданной ячейке таблицы из 16 ячеек
+ *                        (таблица заводит 16 ячеек при первой вставке и удваивается при заполненности больше половины).
+ * @param  home - начальная ячейка цепочки.
+ * @param  count - количество адресов.
+ * @param  firstPort - порт, с которого начинается подбор.
+ */
+QList<Netcom::AddressKey> keysWithHome(std::size_t home, int count, quint16 firstPort = 1)
+{
+    QList<Netcom::AddressKey> result;
+    for (quint16 port = firstPort; result.size() < count && port != 0; ++port)
+    {
+        Netcom::AddressKey key(QHostAddress("192.168.0.1"), port);
+        if ((key.hash() & 15u) == home)
+        {
+            result.append(key);
+        }
+    }
+    return result;
+}
+
+}
+
+class TablesTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void slotLookupTest()
+    {
+        using namespace Netcom;
+
+        ConnectionTable<qint64> table;
+        const ConnectionId first = table.insert(100, 100);
+        const ConnectionId second = table.insert(200, 200);
+        QVERIFY(first != 0);
+        QVERIFY(second != 0);
+        QVERIFY(first != second);
+        QCOMPARE(table.size(), 2);
+        QCOMPARE(*table.find(first), qint64(100));
+        QCOMPARE(*table.find(second), qint64(200));
+
+        qint64 taken = 0;
+        QVERIFY(table.take(first, &taken));
+        QCOMPARE(taken, qint64(100));
+        QVERIFY(!table.take(first, nullptr));
+        QVERIFY(table.find(first) == nullptr);
+
+        // освободившийся дескриптор используется повторно, но прежний идентификатор к нему не подходит.
+        const ConnectionId third = table.insert(300, 300);
+        QVERIFY(third != first);
+        QVERIFY(table.find(first) == nullptr);
+        QCOMPARE(*table.find(third), qint64(300));
+        QCOMPARE(*table.find(second), qint64(200));
+
+        int count = 0;
+        for (ConnectionTable<qint64>::const_iterator it = table.begin(); it != table.end(); ++it)
+        {
+            QCOMPARE(*table.find(it.key()), it.value());
+            ++count;
+        }
+        QCOMPARE(count, table.size());
+    }
+
+    void slotSinceOutOfOrderTest()
+    {
+        using namespace Netcom;
+
+        // после перевода часов назад время подключения меньше, чем у подключившихся раньше.
+        ConnectionTable<qint64> table;
+        table.insert(100, 100);
+        const ConnectionId removed = table.insert(200, 200);
+        table.insert(300, 300);
+        table.insert(150, 150);
+        table.insert(250, 250);
+        table.insert(50, 50);
+
+        QCOMPARE(since(table, 150), QList<qint64>({ 150, 200, 250, 300 }));
+        QCOMPARE(since(table, 301), QList<qint64>());
+        QCOMPARE(since(table, std::numeric_limits<qint64>::min()), QList<qint64>({ 50, 100, 150, 200, 250, 300 }));
+
+        QVERIFY(table.take(removed, nullptr));
+        QCOMPARE(since(table, 150), QList<qint64>({ 150, 250, 300 }));
+
+        QList<qint64> stopped;
+        table.forEachSince(100, [&stopped](qint64 each)
+        {
+            stopped.append(each);
+            return stopped.size() < 2;
+        });
+        QCOMPARE(stopped, QList<qint64>({ 100, 150 }));
+    }
+
+    void slotAddressTableTest()
+    {
+        using namespace Netcom;
+
+        AddressTable<int> table;
+        const AddressKey ipv4(QHostAddress("10.0.0.1"), 1000);
+        const AddressKey mapped(QHostAddress("::ffff:10.0.0.1"), 1000);
+        const AddressKey ipv6(QHostAddress("2001:db8::1"), 1000);
+        const AddressKey otherPort(QHostAddress("10.0.0.1"), 1001);
+
+        QVERIFY(table.find(ipv4) == nullptr);
+        QVERIFY(!table.remove(ipv4));
+
+        table.insert(ipv4) = 1;
+        table.insert(ipv6) = 2;
+        table.insert(otherPort) = 3;
+        QCOMPARE(table.size(), 3);
+        QVERIFY(ipv4 == mapped);
+        QCOMPARE(*table.find(mapped), 1);
+        QCOMPARE(*table.find(ipv6), 2);
+        QCOMPARE(*table.find(otherPort), 3);
+
+        // повторная вставка возвращает имеющееся значение.
+        QCOMPARE(table.insert(ipv4), 1);
+        QCOMPARE(table.size(), 3);
+
+        QVERIFY(table.remove(ipv4));
+        QVERIFY(!table.remove(ipv4));
+        QVERIFY(table.find(ipv4) == nullptr);
+        QCOMPARE(*table.find(ipv6), 2);
+        QCOMPARE(*table.find(otherPort), 3);
+        QCOMPARE(table.size(), 2);
+
+        table.clear();
+        QCOMPARE(table.size(), 0);
+        QVERIFY(table.find(ipv6) == nullptr);
+    }
+
+    void slotAddressTableWrapTest()
+    {
+        using namespace Netcom;
+
+        // цепочка начинается в последней ячейке и продолжается с начала массива: 15, 0, 1, 2.
+        const QList<AddressKey> last = keysWithHome(15, 3);
+        const QList<AddressKey> first = keysWithHome(0, 1);
+        QCOMPARE(last.size(), 3);
+        QCOMPARE(first.size(), 1);
+
+        const QList<AddressKey> keys = QList<AddressKey>() << last << first;
+        for (int removed = 0; removed < keys.size(); ++removed)
+        {
+            AddressTable<int> table;
+            for (int i = 0; i < keys.size(); ++i)
+            {
+                table.insert(keys.at(i)) = i;
+            }
+
+            QVERIFY(table.remove(keys.at(removed)));
+            QCOMPARE(table.size(), keys.size() - 1);
+            for (int i = 0; i < keys.size(); ++i)
+            {
+                if (i == removed)
+                {
+                    QVERIFY(table.find(keys.at(i)) == nullptr);
+                }
+                else
+                {
+                    QVERIFY(table.find(keys.at(i)) != nullptr);
+                    QCOMPARE(*table.find(keys.at(i)), i);
+                }
+            }
+        }
+    }
+
+    void slotAddressTableGrowTest()
+    {
+        using namespace Netcom;
+
+        // заполненность многократно превышает половину начального размера, таблица несколько раз удваивается.
+        const int count = 1000;
+        AddressTable<int> table;
+        for (int i = 0; i < count; ++i)
+        {
+            table.insert(AddressKey(QHostAddress(QString("10.0.%1.%2").arg(i / 256).arg(i % 256)), 5000)) = i;
+        }
+        QCOMPARE(table.size(), count);
+        for (int i = 0; i < count; ++i)
+        {
+            const int* value = table.find(AddressKey(QHostAddress(QString("10.0.%1.%2").arg(i / 256).arg(i % 256)), 5000));
+            QVERIFY(value != nullptr);
+            QCOMPARE(*value, i);
+        }
+
+        for (int i = 0; i < count; i += 2)
+        {
+            QVERIFY(table.remove(AddressKey(QHostAddress(QString("10.0.%1.%2").arg(i / 256).arg(i % 256)), 5000)));
+        }
+        QCOMPARE(table.size(), count / 2);
+        for (int i = 0; i < count; ++i)
+        {
+            const int* value = table.find(AddressKey(QHostAddress(QString("10.0.%1.%2").arg(i / 256).arg(i % 256)), 5000));
+            QCOMPARE(value != nullptr, i % 2 == 1);
+        }
+    }
+
+    void slotAddressTableReferenceTest()
+    {
+        using namespace Netcom;
+
+        AddressTable<int> table;
+        const AddressKey key(QHostAddress("10.0.0.1"), 1000);
+        const AddressKey other(QHostAddress("10.0.0.2"), 1000);
+        table.insert(other) = 2;
+        int& value = table.insert(key);
+        value = 1;
+
+        // между вставками и удалениями ссылка остаётся действительной при любых поисках.
+        int* founded = nullptr;
+        for (int i = 0; i < 100; ++i)
+        {
+            founded = table.find(key);
+            QVERIFY(founded == &value);
+            QVERIFY(table.find(other) != nullptr);
+            QVERIFY(table.find(AddressKey(QHostAddress("10.0.0.3"), 1000)) == nullptr);
+        }
+        QCOMPARE(*founded, 1);
+    }
+
+};
+
+QTEST_MAIN(TablesTest)
+
+#include "main.moc"
@@ -0,0 +1,35 @@
+TEMPLATE = app
+PROJECT = server-test
+TARGET = $$PROJECT
+
+QT += core \
+      network \
+      testlib
+QT -= gui
+
+CONFIG += warn_on
+QMAKE_CXXFLAGS += -Wall -Werror -Wextra -pedantic-errors
+QMAKE_CXXFLAGS += -std=c++14
+
+DESTDIR = $$PWD/build/sbin
+OBJECTS_DIR = $$PWD/build/obj
+MOC_DIR = $$PWD/build/moc
+
+SOURCES = \
+    ../src/addresstable.cpp \
+    src/main.cpp
+
+HEADERS = \
+    ../src/addresstable.h \
+    ../src/connectiontable.h
+
+#installs
+target.path = $$PREFIX/sbin
+
+INSTALLS += \
+    target
+
+INCLUDEPATH += ../src
+INCLUDEPATH += $$PREFIX/include
+
+LIBS += -L$$PREFIX/lib -lprotocol
@@ -5,7 +5,27 @@ CONFIG += ordered
 SUBDIRS += \
     protocol \
     server \
-    client
+    client \
+    journal \
+    protocol_tests \
+    protocol_benchmarks \
+    server_tests \
+    server_benchmarks
 
 server.depends = protocol
 client.depends = protocol
+
+journal.subdir = server/journal
+journal.depends = protocol
+
+protocol_tests.subdir = protocol/tests
+protocol_tests.depends = protocol
+
+protocol_benchmarks.subdir = protocol/benchmarks
+protocol_benchmarks.depends = protocol
+
+server_tests.subdir = server/tests
+server_tests.depends = protocol
+
+server_benchmarks.subdir = server/benchmarks
+server_benchmarks.depends = protocol